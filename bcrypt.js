@@ -4,6 +4,7 @@ const bindings = require('node-gyp-build')(path.resolve(__dirname));
 const crypto = require('crypto');
 
 const promises = require('./promises');
+const Blowfish = require('./blowfish');
 
 /// generate a salt (sync)
 /// @param {Number} [rounds] number of rounds (default 10)
@@ -78,6 +79,203 @@ function genSalt(rounds, minor, cb) {
     });
 }
 
+// the sync watchdog options while it is enabled
+let syncWatchdog = null;
+const NO_CALLER = Object.freeze([]);
+
+/// @return {Array} the location of the code calling into bcrypt and, if
+/// the watchdog captures stacks, its stack; empty if the watchdog is off
+function syncCaller() {
+    if (!syncWatchdog) {
+        return NO_CALLER;
+    }
+    const limit = Error.stackTraceLimit;
+    const holder = {};
+    Error.stackTraceLimit = syncWatchdog.captureStack ? 16 : 4;
+    Error.captureStackTrace(holder, syncCaller);
+    Error.stackTraceLimit = limit;
+    const frames = holder.stack.split('\n').slice(1)
+        .map(frame => frame.trim())
+        .filter(frame => !frame.includes(__filename));
+    const site = frames.length ? frames[0].replace(/^at /, '') : '<unknown>';
+    return syncWatchdog.captureStack ? [site, frames.join('\n')] : [site];
+}
+
+const SYNC_POLICIES = ['warn', 'throw', 'reject'];
+
+/// Times every sync hash and compare, which block the event loop, and
+/// keeps per call site stats. A call taking longer than `threshold`
+/// milliseconds emits a warning (policy 'warn'), or throws after it has run
+/// (policy 'throw'). Policy 'reject' throws before running a call whose
+/// cost is expected to take longer than `threshold`, based on the times
+/// of earlier calls, without blocking; calls that run long anyway warn.
+/// @param {Object|Boolean} options threshold (default 50), policy (default 'warn') and captureStack (default false); false disables the watchdog
+function watchSyncCalls(options) {
+    if (options === false) {
+        syncWatchdog = null;
+        bindings.set_sync_watchdog(false);
+        return;
+    }
+
+    options = Object.assign({ threshold: 50, policy: 'warn', captureStack: false }, options);
+    if (typeof options.threshold !== 'number' || !(options.threshold >= 0)) {
+        throw new Error('threshold must be a non-negative number of milliseconds');
+    }
+    const policy = SYNC_POLICIES.indexOf(options.policy);
+    if (policy < 0) {
+        throw new Error('policy must be one of ' + SYNC_POLICIES.join(', '));
+    }
+
+    syncWatchdog = { captureStack: !!options.captureStack };
+    bindings.set_sync_watchdog(true, Math.round(options.threshold * 1000), policy, function (message, stack) {
+        process.emitWarning(message, { type: 'BcryptSyncWarning', detail: stack });
+    });
+}
+
+/// @return {Object} enabled, and per call site calls, slow, rejected,
+/// totalTime and maxTime in microseconds, a histogram and the stack of the
+/// slowest call over the threshold if captured
+function syncCallStats() {
+    return bindings.sync_watchdog_stats();
+}
+
+// Adaptive inline execution: jobs whose cost has recently taken no more
+// than the budget run on the JS thread instead of the thread pool, where
+// the round trip can cost as much as a cheap hash. Times are microseconds.
+const inlining = {
+    budget: 0,
+    costTime: new Float64Array(32),
+    inline: 0,
+    offloaded: 0,
+};
+
+/// @return {Number} the cost of a salt or hash, or -1 if it has none
+function hashCost(hash) {
+    const match = /^\$2[ab]?\$(\d\d)\$/.exec(hash);
+    return match && match[1] < 32 ? Number(match[1]) : -1;
+}
+
+function recordCostTime(cost, time) {
+    const recent = inlining.costTime[cost];
+    inlining.costTime[cost] = recent > 0 ? 0.75 * recent + 0.25 * time : time;
+}
+
+/// Runs a hash or compare on the thread pool with asyncFn, or inline with
+/// syncFn when inline execution is on and the cost is known to be cheap.
+/// Inline results are still delivered asynchronously, on a microtask.
+/// Tenant jobs always go through the pool so their limits apply.
+function dispatch(syncFn, asyncFn, data, salt, cb, tenantId) {
+    const cost = inlining.budget > 0 && tenantId === undefined ? hashCost(salt) : -1;
+    if (cost < 0) {
+        return asyncFn(data, salt, cb, tenantId);
+    }
+
+    const expected = inlining.costTime[cost];
+    if (expected > 0 && expected <= inlining.budget) {
+        let result;
+        let error;
+        let time = 0;
+        try {
+            result = syncFn(data, salt);
+            // thread CPU time, the clock the thread pool reports
+            time = bindings.sync_cpu_time();
+        } catch (err) {
+            error = err;
+        }
+        if (time > 0) {
+            recordCostTime(cost, time);
+        }
+        inlining.inline++;
+        return queueMicrotask(function () {
+            if (error) {
+                return cb(error);
+            }
+            cb(undefined, result, time);
+        });
+    }
+
+    inlining.offloaded++;
+    return asyncFn(data, salt, function (err, result, cpuTime) {
+        // coalesced compares report no time of their own
+        if (!err && cpuTime > 0) {
+            recordCostTime(cost, cpuTime);
+        }
+        cb(err, result, cpuTime);
+    }, tenantId);
+}
+
+/// Runs async hashes and compares of a cost whose recent CPU time is at
+/// most `budget` milliseconds on the JS thread instead of the thread pool.
+/// A cost is measured on the pool first, and re-measured on every run.
+/// @param {Number} budget milliseconds, 0 (the default) to always use the thread pool
+function setInlineBudget(budget) {
+    if (typeof budget !== 'number' || !(budget >= 0)) {
+        throw new Error('budget must be a non-negative number of milliseconds');
+    }
+    inlining.budget = budget * 1000;
+}
+
+/// @return {Object} budget in milliseconds, inline and offloaded job counts
+/// and costTime, the recent time of each measured cost in microseconds
+function inlineStats() {
+    const costTime = {};
+    inlining.costTime.forEach(function (time, cost) {
+        if (time > 0) {
+            costTime[cost] = time;
+        }
+    });
+    return {
+        budget: inlining.budget / 1000,
+        inline: inlining.inline,
+        offloaded: inlining.offloaded,
+        costTime,
+    };
+}
+
+// whether a breached password filter is loaded
+let breachFilterLoaded = false;
+
+/// Loads a breached password filter, built with `bcrypt filter` from
+/// SHA-1 lists. While one is loaded, every hash function rejects data in
+/// it before spending any time on bcrypt. The file is memory-mapped, so
+/// processes loading the same file share it through the page cache.
+/// @param {String|null} path the filter file, or null to unload the filter
+/// @return {Object|undefined} entries, bitsPerEntry, hashes and size in bytes of the filter
+function loadBreachFilter(path) {
+    if (path == null) {
+        breachFilterLoaded = false;
+        return bindings.load_breach_filter(null);
+    }
+
+    if (typeof path !== 'string') {
+        throw new Error('path must be a string');
+    }
+
+    const info = bindings.load_breach_filter(path);
+    breachFilterLoaded = true;
+    return info;
+}
+
+/// @param {String|Buffer} data the data to check
+/// @return {bool} true if data may be in the loaded breached password filter
+function isBreached(data) {
+    if (!(typeof data === 'string' || data instanceof Buffer)) {
+        throw new Error('data must be a string or Buffer');
+    }
+
+    return breachFilterLoaded && bindings.breach_filter_test(crypto.createHash('sha1').update(data).digest());
+}
+
+/// @return {Error|undefined} the error hashing data fails with if it is breached
+function breachError(data) {
+    if (!breachFilterLoaded || !isBreached(data)) {
+        return;
+    }
+    const error = new Error('data appears in the breached password filter');
+    error.code = 'EBREACHED';
+    return error;
+}
+
 /// hash data using a salt
 /// @param {String|Buffer} data the data to encrypt
 /// @param {String} salt the salt to use when hashing
@@ -91,19 +289,25 @@ function hashSync(data, salt) {
         throw new Error('data must be a string or Buffer and salt must either be a salt string or a number of rounds');
     }
 
+    const breached = breachError(data);
+    if (breached) {
+        throw breached;
+    }
+
     if (typeof salt === 'number') {
         salt = module.exports.genSaltSync(salt);
     }
 
-    return bindings.encrypt_sync(data, salt);
+    return bindings.encrypt_sync(data, salt, ...syncCaller());
 }
 
 /// hash data using a salt
 /// @param {String|Buffer} data the data to encrypt
 /// @param {String} salt the salt to use when hashing
-/// @param {Function} cb callback(err, hash)
+/// @param {Function} cb callback(err, hash, cpuTime)
 function hash(data, salt, cb) {
     let error;
+    const tenantId = tenantKey(this);
 
     if (typeof data === 'function') {
         error = new Error('data must be a string or Buffer and salt must either be a salt string or a number of rounds');
@@ -144,13 +348,20 @@ function hash(data, salt, cb) {
     }
 
 
+    error = breachError(data);
+    if (error) {
+        return process.nextTick(function () {
+            cb(error);
+        });
+    }
+
     if (typeof salt === 'number') {
         return module.exports.genSalt(salt, function (err, salt) {
-            return bindings.encrypt(data, salt, cb);
+            return dispatch(bindings.encrypt_sync, bindings.encrypt, data, salt, cb, tenantId);
         });
     }
 
-    return bindings.encrypt(data, salt, cb);
+    return dispatch(bindings.encrypt_sync, bindings.encrypt, data, salt, cb, tenantId);
 }
 
 /// compare raw data to hash
@@ -166,15 +377,16 @@ function compareSync(data, hash) {
         throw new Error('data must be a string or Buffer and hash must be a string');
     }
 
-    return bindings.compare_sync(data, hash);
+    return bindings.compare_sync(data, hash, ...syncCaller());
 }
 
 /// compare raw data to hash
 /// @param {String|Buffer} data the data to hash and compare
 /// @param {String} hash expected hash
-/// @param {Function} cb callback(err, matched) - matched is true if hashed data matches hash
+/// @param {Function} cb callback(err, matched, cpuTime) - matched is true if hashed data matches hash
 function compare(data, hash, cb) {
     let error;
+    const tenantId = tenantKey(this);
 
     if (typeof data === 'function') {
         error = new Error('data and hash arguments required');
@@ -214,7 +426,658 @@ function compare(data, hash, cb) {
         });
     }
 
-    return bindings.compare(data, hash, cb);
+    return dispatch(bindings.compare_sync, bindings.compare, data, hash, cb, tenantId);
+}
+
+/// hash data using a salt into the 41 byte binary form (sync)
+/// @param {String|Buffer} data the data to encrypt
+/// @param {String|Number} salt the salt to use when hashing, or a number of rounds
+/// @return {Buffer} binary hash
+function hashBinarySync(data, salt) {
+    if (data == null || salt == null) {
+        throw new Error('data and salt arguments required');
+    }
+
+    if (!(typeof data === 'string' || data instanceof Buffer) || (typeof salt !== 'string' && typeof salt !== 'number')) {
+        throw new Error('data must be a string or Buffer and salt must either be a salt string or a number of rounds');
+    }
+
+    const breached = breachError(data);
+    if (breached) {
+        throw breached;
+    }
+
+    if (typeof salt === 'number') {
+        salt = module.exports.genSaltSync(salt);
+    }
+
+    return bindings.encrypt_binary_sync(data, salt, ...syncCaller());
+}
+
+/// hash data using a salt into the 41 byte binary form
+/// @param {String|Buffer} data the data to encrypt
+/// @param {String|Number} salt the salt to use when hashing, or a number of rounds
+/// @param {Function} cb callback(err, hash, cpuTime)
+function hashBinary(data, salt, cb) {
+    let error;
+    const tenantId = tenantKey(this);
+
+    // cb exists but is not a function
+    // return a rejecting promise
+    if (cb && typeof cb !== 'function') {
+        return promises.reject(new Error('cb must be a function or null to return a Promise'));
+    }
+
+    if (!cb) {
+        return promises.promise(hashBinary, this, [data, salt]);
+    }
+
+    if (data == null || salt == null) {
+        error = new Error('data and salt arguments required');
+        return process.nextTick(function () {
+            cb(error);
+        });
+    }
+
+    if (!(typeof data === 'string' || data instanceof Buffer) || (typeof salt !== 'string' && typeof salt !== 'number')) {
+        error = new Error('data must be a string or Buffer and salt must either be a salt string or a number of rounds');
+        return process.nextTick(function () {
+            cb(error);
+        });
+    }
+
+    error = breachError(data);
+    if (error) {
+        return process.nextTick(function () {
+            cb(error);
+        });
+    }
+
+    if (typeof salt === 'number') {
+        return module.exports.genSalt(salt, function (err, salt) {
+            if (err) {
+                return cb(err);
+            }
+            return bindings.encrypt_binary(data, salt, cb, tenantId);
+        });
+    }
+
+    return bindings.encrypt_binary(data, salt, cb, tenantId);
+}
+
+/// compare raw data to a binary hash
+/// @param {String|Buffer} data the data to hash and compare
+/// @param {Buffer} hash expected hash in the 41 byte binary form
+/// @return {bool} true if hashed data matches hash
+function compareBinarySync(data, hash) {
+    if (data == null || hash == null) {
+        throw new Error('data and hash arguments required');
+    }
+
+    if (!(typeof data === 'string' || data instanceof Buffer) || !(hash instanceof Buffer)) {
+        throw new Error('data must be a string or Buffer and hash must be a Buffer');
+    }
+
+    return bindings.compare_binary_sync(data, hash, ...syncCaller());
+}
+
+/// compare raw data to a binary hash
+/// @param {String|Buffer} data the data to hash and compare
+/// @param {Buffer} hash expected hash in the 41 byte binary form
+/// @param {Function} cb callback(err, matched, cpuTime) - matched is true if hashed data matches hash
+function compareBinary(data, hash, cb) {
+    let error;
+    const tenantId = tenantKey(this);
+
+    // cb exists but is not a function
+    // return a rejecting promise
+    if (cb && typeof cb !== 'function') {
+        return promises.reject(new Error('cb must be a function or null to return a Promise'));
+    }
+
+    if (!cb) {
+        return promises.promise(compareBinary, this, [data, hash]);
+    }
+
+    if (data == null || hash == null) {
+        error = new Error('data and hash arguments required');
+        return process.nextTick(function () {
+            cb(error);
+        });
+    }
+
+    if (!(typeof data === 'string' || data instanceof Buffer) || !(hash instanceof Buffer)) {
+        error = new Error('data must be a string or Buffer and hash must be a Buffer');
+        return process.nextTick(function () {
+            cb(error);
+        });
+    }
+
+    if (hash.length !== 41) {
+        error = new Error('hash must be a 41 byte Buffer');
+        return process.nextTick(function () {
+            cb(error);
+        });
+    }
+
+    return bindings.compare_binary(data, hash, cb, tenantId);
+}
+
+/// @return {Error|undefined} why candidates and hash cannot be compared
+function compareAnyError(candidates, hash) {
+    if (!Array.isArray(candidates) || candidates.length < 1 || candidates.length > 16) {
+        return new Error('candidates must be an array of 1 to 16 strings or Buffers');
+    }
+    if (!candidates.every(candidate => typeof candidate === 'string' || candidate instanceof Buffer)) {
+        return new Error('candidates must be an array of 1 to 16 strings or Buffers');
+    }
+    if (!(typeof hash === 'string' || hash instanceof Buffer)) {
+        return new Error('hash must be a string or Buffer');
+    }
+    if (hash instanceof Buffer && hash.length !== 41) {
+        return new Error('hash must be a 41 byte Buffer');
+    }
+}
+
+/// compare several candidates for the data, in order of preference, to one hash
+/// @param {Array} candidates up to 16 strings or Buffers
+/// @param {String|Buffer} hash expected hash, as a string or in the binary form
+/// @return {Number} index of the first candidate that matches, or -1
+function compareAnySync(candidates, hash) {
+    if (candidates == null || hash == null) {
+        throw new Error('candidates and hash arguments required');
+    }
+
+    const error = compareAnyError(candidates, hash);
+    if (error) {
+        throw error;
+    }
+
+    return bindings.compare_any_sync(candidates, hash, ...syncCaller());
+}
+
+/// compare several candidates for the data, in order of preference, to one
+/// hash in a single thread pool job that stops at the first match
+/// @param {Array} candidates up to 16 strings or Buffers
+/// @param {String|Buffer} hash expected hash, as a string or in the binary form
+/// @param {Function} cb callback(err, index, cpuTime) - index of the first candidate that matches, or -1
+function compareAny(candidates, hash, cb) {
+    let error;
+    const tenantId = tenantKey(this);
+
+    // cb exists but is not a function
+    // return a rejecting promise
+    if (cb && typeof cb !== 'function') {
+        return promises.reject(new Error('cb must be a function or null to return a Promise'));
+    }
+
+    if (!cb) {
+        return promises.promise(compareAny, this, [candidates, hash]);
+    }
+
+    if (candidates == null || hash == null) {
+        error = new Error('candidates and hash arguments required');
+        return process.nextTick(function () {
+            cb(error);
+        });
+    }
+
+    error = compareAnyError(candidates, hash);
+    if (error) {
+        return process.nextTick(function () {
+            cb(error);
+        });
+    }
+
+    return bindings.compare_any(candidates, hash, cb, tenantId);
+}
+
+/// @param {String} hash a bcrypt hash string
+/// @return {Buffer} the 41 byte binary form of hash
+function toBinary(hash) {
+    if (hash == null) {
+        throw new Error('hash argument required');
+    }
+
+    if (typeof hash !== 'string') {
+        throw new Error('hash must be a string');
+    }
+
+    return bindings.to_binary(hash);
+}
+
+/// @param {Buffer} hash a hash in the 41 byte binary form
+/// @return {String} the bcrypt hash string
+function fromBinary(hash) {
+    if (hash == null) {
+        throw new Error('hash argument required');
+    }
+
+    if (!(hash instanceof Buffer)) {
+        throw new Error('hash must be a Buffer');
+    }
+
+    return bindings.from_binary(hash);
+}
+
+// bytes a bcrypt hash string takes
+const HASH_LENGTH = 60;
+
+/// @return {Error|undefined} why output cannot take a hash at offset
+function outputError(output, offset) {
+    if (!(output instanceof Buffer)) {
+        return new Error('output must be a Buffer');
+    }
+    if (!Number.isInteger(offset) || offset < 0 || offset + HASH_LENGTH > output.length) {
+        return new Error('output must have ' + HASH_LENGTH + ' bytes available at offset');
+    }
+}
+
+/// hash data using a salt, writing the hash into a Buffer (sync)
+/// @param {String|Buffer} data the data to encrypt
+/// @param {String|Number} salt the salt to use when hashing, or a number of rounds
+/// @param {Buffer} output receives the hash as ASCII
+/// @param {Number} [offset] where in output to write, default 0
+/// @return {Number} bytes written
+function hashIntoSync(data, salt, output, offset) {
+    if (data == null || salt == null) {
+        throw new Error('data and salt arguments required');
+    }
+
+    if (!(typeof data === 'string' || data instanceof Buffer) || (typeof salt !== 'string' && typeof salt !== 'number')) {
+        throw new Error('data must be a string or Buffer and salt must either be a salt string or a number of rounds');
+    }
+
+    if (offset == null) {
+        offset = 0;
+    }
+    const error = outputError(output, offset);
+    if (error) {
+        throw error;
+    }
+
+    const breached = breachError(data);
+    if (breached) {
+        throw breached;
+    }
+
+    if (typeof salt === 'number') {
+        salt = module.exports.genSaltSync(salt);
+    }
+
+    return bindings.encrypt_into_sync(data, salt, output, offset, ...syncCaller());
+}
+
+/// hash data using a salt, writing the hash into a Buffer
+/// @param {String|Buffer} data the data to encrypt
+/// @param {String|Number} salt the salt to use when hashing, or a number of rounds
+/// @param {Buffer} output receives the hash as ASCII; must not be modified until cb is called
+/// @param {Number} [offset] where in output to write, default 0
+/// @param {Function} cb callback(err, bytesWritten, cpuTime)
+function hashInto(data, salt, output, offset, cb) {
+    let error;
+    const tenantId = tenantKey(this);
+
+    if (typeof offset === 'function') {
+        cb = offset;
+        offset = undefined;
+    }
+
+    // cb exists but is not a function
+    // return a rejecting promise
+    if (cb && typeof cb !== 'function') {
+        return promises.reject(new Error('cb must be a function or null to return a Promise'));
+    }
+
+    if (!cb) {
+        return promises.promise(hashInto, this, [data, salt, output, offset]);
+    }
+
+    if (data == null || salt == null) {
+        error = new Error('data and salt arguments required');
+        return process.nextTick(function () {
+            cb(error);
+        });
+    }
+
+    if (!(typeof data === 'string' || data instanceof Buffer) || (typeof salt !== 'string' && typeof salt !== 'number')) {
+        error = new Error('data must be a string or Buffer and salt must either be a salt string or a number of rounds');
+        return process.nextTick(function () {
+            cb(error);
+        });
+    }
+
+    if (offset == null) {
+        offset = 0;
+    }
+    error = outputError(output, offset);
+    if (error) {
+        return process.nextTick(function () {
+            cb(error);
+        });
+    }
+
+    error = breachError(data);
+    if (error) {
+        return process.nextTick(function () {
+            cb(error);
+        });
+    }
+
+    if (typeof salt === 'number') {
+        return module.exports.genSalt(salt, function (err, salt) {
+            if (err) {
+                return cb(err);
+            }
+            return bindings.encrypt_into(data, salt, output, offset, cb, tenantId);
+        });
+    }
+
+    return bindings.encrypt_into(data, salt, output, offset, cb, tenantId);
+}
+
+/// A reusable output Buffer for hashes. Each hash is written into the next
+/// of `slots` fixed size slots, round robin, and returned as a Buffer view
+/// of the slot, so producing hashes allocates no strings. A view stays
+/// valid until `slots` more hashes have been started on the slab; copy it
+/// (or convert it with toString('latin1')) to keep it longer.
+class HashSlab {
+    /// @param {Number} [slots] hashes the slab holds, default 1024
+    constructor(slots) {
+        if (slots == null) {
+            slots = 1024;
+        }
+        if (!Number.isInteger(slots) || slots < 1) {
+            throw new Error('slots must be a positive integer');
+        }
+        this.slots = slots;
+        this.buffer = Buffer.alloc(slots * HashSlab.SLOT_SIZE);
+        this.next = 0;
+    }
+
+    /// @return {Number} offset of the slot to write the next hash into
+    take() {
+        const offset = this.next * HashSlab.SLOT_SIZE;
+        this.next = (this.next + 1) % this.slots;
+        return offset;
+    }
+
+    /// @return {Buffer} view of the hash
+    hashSync(data, salt) {
+        const offset = this.take();
+        const length = hashIntoSync(data, salt, this.buffer, offset);
+        return this.buffer.subarray(offset, offset + length);
+    }
+
+    /// @param {Function} cb callback(err, view, cpuTime)
+    hash(data, salt, cb) {
+        if (cb && typeof cb !== 'function') {
+            return promises.reject(new Error('cb must be a function or null to return a Promise'));
+        }
+
+        if (!cb) {
+            return promises.promise(this.hash, this, [data, salt]);
+        }
+
+        const buffer = this.buffer;
+        const offset = this.take();
+        return hashInto(data, salt, buffer, offset, function (err, length, cpuTime) {
+            if (err) {
+                return cb(err);
+            }
+            cb(null, buffer.subarray(offset, offset + length), cpuTime);
+        });
+    }
+}
+
+// slots are padded past the 60 byte hash to keep them aligned
+HashSlab.SLOT_SIZE = 64;
+
+/// @param {Number} [slots] hashes the slab holds, default 1024
+/// @return {HashSlab}
+function hashSlab(slots) {
+    return new HashSlab(slots);
+}
+
+/// @return {String|undefined} the tenant key of a Tenant context
+function tenantKey(context) {
+    return context instanceof Tenant ? context.key : undefined;
+}
+
+/// Runs hash and compare jobs on behalf of one tenant. The native
+/// dispatcher keeps at most `maxInFlight` of a tenant's jobs on the thread
+/// pool at a time, queueing the rest, and adds up the CPU time they use.
+class Tenant {
+    /// @param {String} key identifies the tenant
+    /// @param {Object} [options] maxInFlight (default 0, unlimited)
+    constructor(key, options) {
+        if (typeof key !== 'string') {
+            throw new Error('key must be a string');
+        }
+        this.key = key;
+        if (options && options.maxInFlight != null) {
+            this.setMaxInFlight(options.maxInFlight);
+        }
+    }
+
+    /// @param {Number} maxInFlight jobs of this tenant on the thread pool at a time, 0 for no limit
+    setMaxInFlight(maxInFlight) {
+        if (!Number.isInteger(maxInFlight) || maxInFlight < 0 || maxInFlight > 0xffffffff) {
+            throw new Error('maxInFlight must be a non-negative integer');
+        }
+        bindings.set_tenant_limit(this.key, maxInFlight);
+    }
+
+    /// @return {Object} maxInFlight, inFlight, pending, completed and cpuTime in microseconds
+    stats() {
+        return bindings.tenant_stats(this.key);
+    }
+
+    /// collect the tenant's usage since it was last taken, and start it over
+    /// @return {Object} completed and cpuTime in microseconds
+    takeStats() {
+        return bindings.take_tenant_usage(this.key);
+    }
+
+    hash(data, salt, cb) {
+        return hash.call(this, data, salt, cb);
+    }
+
+    compare(data, encrypted, cb) {
+        return compare.call(this, data, encrypted, cb);
+    }
+
+    hashInto(data, salt, output, offset, cb) {
+        return hashInto.call(this, data, salt, output, offset, cb);
+    }
+
+    hashBinary(data, salt, cb) {
+        return hashBinary.call(this, data, salt, cb);
+    }
+
+    compareBinary(data, encrypted, cb) {
+        return compareBinary.call(this, data, encrypted, cb);
+    }
+
+    compareAny(candidates, encrypted, cb) {
+        return compareAny.call(this, candidates, encrypted, cb);
+    }
+}
+
+/// @param {String} key identifies the tenant
+/// @param {Object} [options] maxInFlight (default 0, unlimited)
+/// @return {Tenant}
+function tenant(key, options) {
+    return new Tenant(key, options);
+}
+
+/// collect the usage of every tenant since it was last taken, and start it over
+/// @return {Object} { completed, cpuTime } keyed by tenant key
+function takeTenantStats() {
+    return bindings.take_tenant_usage();
+}
+
+/// validate audit arguments, returns the native arguments or throws
+function auditArgs(path, options) {
+    if (typeof path !== 'string') {
+        throw new Error('path must be a string');
+    }
+
+    options = options || {};
+    const column = options.column == null ? -1 : options.column;
+    const delimiter = options.delimiter == null ? ',' : options.delimiter;
+    const minCost = options.minCost == null ? 0 : options.minCost;
+    const threads = options.threads == null ? 0 : options.threads;
+    const maxOffsets = options.maxOffsets == null ? 100000 : options.maxOffsets;
+
+    if (!Number.isInteger(column) || column < -1) {
+        throw new Error('column must be a non-negative integer');
+    }
+    if (typeof delimiter !== 'string' || delimiter.length !== 1) {
+        throw new Error('delimiter must be a single character');
+    }
+    if (!Number.isInteger(minCost) || minCost < 0 || minCost > 31) {
+        throw new Error('minCost must be an integer between 0 and 31');
+    }
+    if (!Number.isInteger(threads) || threads < 0) {
+        throw new Error('threads must be a non-negative integer');
+    }
+    if (!Number.isInteger(maxOffsets) || maxOffsets < 0) {
+        throw new Error('maxOffsets must be a non-negative integer');
+    }
+
+    return [path, column, delimiter, !!options.header, minCost, threads, maxOffsets];
+}
+
+/// audit every hash in a newline or CSV delimited export (sync)
+/// @param {String} path the file to scan
+/// @param {Object} [options] column, delimiter, header, minCost, threads, maxOffsets
+/// @return {Object} counts, version and cost histograms and offsets of bad entries
+function auditSync(path, options) {
+    return bindings.audit_sync(...auditArgs(path, options));
+}
+
+/// audit every hash in a newline or CSV delimited export
+/// @param {String} path the file to scan
+/// @param {Object} [options] column, delimiter, header, minCost, threads, maxOffsets
+/// @param {Function} cb callback(err, report)
+function audit(path, options, cb) {
+    if (typeof options === 'function') {
+        cb = options;
+        options = undefined;
+    }
+
+    // cb exists but is not a function
+    // return a rejecting promise
+    if (cb && typeof cb !== 'function') {
+        return promises.reject(new Error('cb must be a function or null to return a Promise'));
+    }
+
+    if (!cb) {
+        return promises.promise(audit, this, [path, options]);
+    }
+
+    let args;
+    try {
+        args = auditArgs(path, options);
+    } catch (error) {
+        return process.nextTick(function () {
+            cb(error);
+        });
+    }
+
+    return bindings.audit(...args, cb);
+}
+
+/// deliver async results to the JS thread in batches
+/// @param {bool} enabled turn batching on or off
+/// @param {Object} [options] asyncContext (default true): call back in the
+/// async context of each submitting call, for AsyncLocalStorage and async_hooks
+function batchCompletions(enabled, options) {
+    const asyncContext = !options || options.asyncContext == null ? true : options.asyncContext;
+    bindings.set_batch_completions(!!enabled, !!asyncContext);
+}
+
+/// @return {Object} enabled, batches drained, results delivered and results outstanding
+function completionStats() {
+    return bindings.completion_stats();
+}
+
+/// share one computation between identical concurrent compares
+/// @param {bool} enabled turn coalescing on or off
+function coalesceCompares(enabled) {
+    // a fresh key each time keeps flight keys unpredictable
+    bindings.set_compare_coalescing(!!enabled, crypto.randomBytes(32));
+}
+
+/// @return {Object} enabled, flights started, compares joined to a running flight and flights inFlight
+function compareCoalescingStats() {
+    return bindings.compare_coalescing_stats();
+}
+
+/// validate bcrypt_pbkdf arguments, returns an error message or undefined
+function pbkdfArgsError(password, salt, rounds, keyLen) {
+    if (password == null || salt == null || rounds == null || keyLen == null) {
+        return 'password, salt, rounds and keyLen arguments required';
+    }
+
+    if (!(typeof password === 'string' || password instanceof Buffer) || !(typeof salt === 'string' || salt instanceof Buffer)) {
+        return 'password and salt must be strings or Buffers';
+    }
+
+    if (password.length === 0 || salt.length === 0) {
+        return 'password and salt must not be empty';
+    }
+
+    if (!Number.isInteger(rounds) || rounds < 1) {
+        return 'rounds must be a positive integer';
+    }
+
+    if (!Number.isInteger(keyLen) || keyLen < 1 || keyLen > 1024) {
+        return 'keyLen must be an integer between 1 and 1024';
+    }
+}
+
+/// derive a key with bcrypt_pbkdf, as used by OpenSSH private keys (sync)
+/// @param {String|Buffer} password the password to derive the key from
+/// @param {String|Buffer} salt the salt
+/// @param {Number} rounds number of rounds
+/// @param {Number} keyLen length of the key in bytes (at most 1024)
+/// @return {Buffer} key
+function pbkdfSync(password, salt, rounds, keyLen) {
+    const error = pbkdfArgsError(password, salt, rounds, keyLen);
+    if (error) {
+        throw new Error(error);
+    }
+
+    return bindings.pbkdf_sync(password, salt, rounds, keyLen);
+}
+
+/// derive a key with bcrypt_pbkdf, as used by OpenSSH private keys
+/// @param {String|Buffer} password the password to derive the key from
+/// @param {String|Buffer} salt the salt
+/// @param {Number} rounds number of rounds
+/// @param {Number} keyLen length of the key in bytes (at most 1024)
+/// @param {Function} cb callback(err, key)
+function pbkdf(password, salt, rounds, keyLen, cb) {
+    // cb exists but is not a function
+    // return a rejecting promise
+    if (cb && typeof cb !== 'function') {
+        return promises.reject(new Error('cb must be a function or null to return a Promise'));
+    }
+
+    if (!cb) {
+        return promises.promise(pbkdf, this, [password, salt, rounds, keyLen]);
+    }
+
+    const error = pbkdfArgsError(password, salt, rounds, keyLen);
+    if (error) {
+        return process.nextTick(function () {
+            cb(new Error(error));
+        });
+    }
+
+    return bindings.pbkdf(password, salt, rounds, keyLen, cb);
 }
 
 /// @param {String} hash extract rounds from this hash
@@ -239,4 +1102,32 @@ module.exports = {
     compareSync,
     compare,
     getRounds,
+    hashBinarySync,
+    hashBinary,
+    compareBinarySync,
+    compareBinary,
+    toBinary,
+    fromBinary,
+    compareAnySync,
+    compareAny,
+    hashIntoSync,
+    hashInto,
+    hashSlab,
+    watchSyncCalls,
+    setInlineBudget,
+    inlineStats,
+    syncCallStats,
+    auditSync,
+    audit,
+    loadBreachFilter,
+    isBreached,
+    tenant,
+    takeTenantStats,
+    batchCompletions,
+    completionStats,
+    coalesceCompares,
+    compareCoalescingStats,
+    pbkdfSync,
+    pbkdf,
+    Blowfish,
 }
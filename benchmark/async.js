@@ -0,0 +1,79 @@
+// Throughput of the async API at low costs, where per-call dispatch
+// overhead is significant next to the hash itself.
+//
+//   node benchmark/async.js [ops] [concurrency]
+//
+// Worker allocations per op come from the native worker pool counters;
+// after warm-up they should stay at zero. They only count the worker
+// objects: the N-API work handle, callback reference and async resource,
+// and the result value, are still allocated per call and are not
+// measured here. Main-thread time per result is the event loop's active
+// time (performance.eventLoopUtilization) over the run, which is where
+// batched completions should save: compare it across modes rather than
+// throughput, which the thread pool bounds. Every case runs with
+// per-result callbacks, with batched completions, and with batched
+// completions that skip the per-call async context.
+
+const path = require('path');
+const { performance } = require('perf_hooks');
+const bcrypt = require('../bcrypt');
+const bindings = require('node-gyp-build')(path.resolve(__dirname, '..'));
+
+const OPS = Number.parseInt(process.argv[2] || '20000', 10);
+const CONCURRENCY = Number.parseInt(process.argv[3] || '64', 10);
+
+async function run(name, fn) {
+    let issued = 0;
+    const worker = async () => {
+        while (issued < OPS) {
+            issued++;
+            await fn();
+        }
+    };
+
+    const before = bindings.worker_pool_stats();
+    const batchesBefore = bcrypt.completionStats();
+    const loopBefore = performance.eventLoopUtilization();
+    const start = process.hrtime.bigint();
+    await Promise.all(Array.from({length: CONCURRENCY}, worker));
+    const elapsed = Number(process.hrtime.bigint() - start) / 1e9;
+    const loop = performance.eventLoopUtilization(loopBefore);
+    const after = bindings.worker_pool_stats();
+    const batchesAfter = bcrypt.completionStats();
+
+    const allocated = after.allocated - before.allocated;
+    const batches = batchesAfter.batches - batchesBefore.batches;
+    const batchSize = batches ? (batchesAfter.delivered - batchesBefore.delivered) / batches : 1;
+    console.log(`${name.padEnd(32)} ${(OPS / elapsed).toFixed(0).padStart(8)} ops/s` +
+        `  ${(loop.active * 1000 / OPS).toFixed(2).padStart(6)} main-thread us/result` +
+        `  ${(allocated / OPS).toFixed(4)} worker allocs/op` +
+        `  (${after.reused - before.reused} reused)` +
+        `  ${batchSize.toFixed(1)} results/delivery`);
+}
+
+async function main() {
+    for (const cost of [4, 5, 6]) {
+        const salt = bcrypt.genSaltSync(cost);
+        const hash = bcrypt.hashSync('password', salt);
+
+        // warm the pool up to the working set before measuring
+        await Promise.all(Array.from({length: CONCURRENCY}, () => bcrypt.compare('password', hash)));
+
+        const modes = [
+            ['', false],
+            [' batched', true, {}],
+            [' batched, no context', true, { asyncContext: false }],
+        ];
+        for (const [mode, batched, options] of modes) {
+            bcrypt.batchCompletions(batched, options);
+            await run(`hash cost ${cost}${mode}`, () => bcrypt.hash('password', salt));
+            await run(`compare cost ${cost}${mode}`, () => bcrypt.compare('password', hash));
+        }
+        bcrypt.batchCompletions(false);
+    }
+}
+
+main().catch((err) => {
+    console.error(err);
+    process.exit(1);
+});
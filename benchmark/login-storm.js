@@ -0,0 +1,229 @@
+// Open-loop load generator for the async API.
+//
+// Requests arrive on a Poisson schedule that does not wait for earlier
+// requests to finish, the way logins arrive at a real service, so queueing
+// in the thread pool shows up as latency instead of silently lowering the
+// offered load. Latency is measured from the scheduled arrival time.
+//
+//   node benchmark/login-storm.js [--option=value ...]
+//
+// Options:
+//   --rate=200          mean arrivals per second
+//   --duration=10       seconds of offered load
+//   --burst-rate=0      arrivals per second during bursts (0 disables bursts)
+//   --burst-every=5     seconds between the start of bursts
+//   --burst-length=1    seconds each burst lasts
+//   --costs=10          cost mix, e.g. "4:0.7,10:0.3" (cost:weight)
+//   --compare=0.9       fraction of requests that are compares, rest are hashes
+//   --sample=100        milliseconds between queue depth / loop lag samples
+//   --out=file.json     write results to a file instead of stdout
+//
+// The thread pool size is taken from UV_THREADPOOL_SIZE as usual.
+
+const fs = require('fs');
+const { monitorEventLoopDelay } = require('perf_hooks');
+const bcrypt = require('../bcrypt');
+
+function parseArgs(argv) {
+    const options = {
+        rate: 200,
+        duration: 10,
+        burstRate: 0,
+        burstEvery: 5,
+        burstLength: 1,
+        costs: '10',
+        compare: 0.9,
+        sample: 100,
+        out: null,
+    };
+
+    for (const arg of argv) {
+        const match = /^--([a-z-]+)=(.*)$/.exec(arg);
+        if (!match) {
+            throw new Error(`unrecognized argument: ${arg}`);
+        }
+        const key = match[1].replace(/-([a-z])/g, (_, c) => c.toUpperCase());
+        if (!(key in options)) {
+            throw new Error(`unknown option: --${match[1]}`);
+        }
+        options[key] = typeof options[key] === 'number' ? Number(match[2]) : match[2];
+    }
+
+    options.costs = options.costs.split(',').map((entry) => {
+        const [cost, weight] = entry.split(':');
+        return { cost: Number(cost), weight: weight === undefined ? 1 : Number(weight) };
+    });
+
+    return options;
+}
+
+function pickCost(costs, total) {
+    let r = Math.random() * total;
+    for (const entry of costs) {
+        r -= entry.weight;
+        if (r < 0) {
+            return entry.cost;
+        }
+    }
+    return costs[costs.length - 1].cost;
+}
+
+function percentile(sorted, p) {
+    if (sorted.length === 0) {
+        return null;
+    }
+    const index = Math.min(sorted.length - 1, Math.ceil(p * sorted.length) - 1);
+    return sorted[Math.max(0, index)];
+}
+
+function summarize(latencies) {
+    const sorted = Float64Array.from(latencies).sort();
+    const sum = latencies.reduce((a, b) => a + b, 0);
+    return {
+        count: sorted.length,
+        mean: sorted.length ? sum / sorted.length : null,
+        p50: percentile(sorted, 0.50),
+        p99: percentile(sorted, 0.99),
+        p999: percentile(sorted, 0.999),
+        max: sorted.length ? sorted[sorted.length - 1] : null,
+    };
+}
+
+async function main() {
+    const options = parseArgs(process.argv.slice(2));
+    const totalWeight = options.costs.reduce((a, c) => a + c.weight, 0);
+
+    // one fixture per cost so the storm measures bcrypt, not salt generation
+    const fixtures = new Map();
+    for (const { cost } of options.costs) {
+        const salt = bcrypt.genSaltSync(cost);
+        fixtures.set(cost, { salt, hash: bcrypt.hashSync('correct horse', salt) });
+    }
+
+    const latencies = { compare: [], hash: [] };
+    const byCost = new Map();
+    const timeline = [];
+    let issued = 0;
+    let inFlight = 0;
+    let completed = 0;
+    let errors = 0;
+
+    const loopDelay = monitorEventLoopDelay({ resolution: 10 });
+    loopDelay.enable();
+
+    const start = performance.now();
+    const end = start + options.duration * 1000;
+
+    const rateAt = (t) => {
+        if (options.burstRate > 0) {
+            const offset = ((t - start) / 1000) % options.burstEvery;
+            if (offset < options.burstLength) {
+                return options.burstRate;
+            }
+        }
+        return options.rate;
+    };
+
+    function issue(scheduled) {
+        const cost = pickCost(options.costs, totalWeight);
+        const fixture = fixtures.get(cost);
+        const kind = Math.random() < options.compare ? 'compare' : 'hash';
+        const request = kind === 'compare'
+            ? bcrypt.compare('correct horse', fixture.hash)
+            : bcrypt.hash('correct horse', fixture.salt);
+
+        issued++;
+        inFlight++;
+        request.then(() => {
+            const latency = performance.now() - scheduled;
+            latencies[kind].push(latency);
+            if (!byCost.has(cost)) {
+                byCost.set(cost, []);
+            }
+            byCost.get(cost).push(latency);
+        }, () => {
+            errors++;
+        }).finally(() => {
+            inFlight--;
+            completed++;
+        });
+    }
+
+    // sample queue depth and loop lag until the backlog drains
+    let lastSample = start;
+    const sampler = setInterval(() => {
+        const now = performance.now();
+        timeline.push({
+            t: Math.round(now - start),
+            inFlight,
+            completed,
+            lag: Math.max(0, now - lastSample - options.sample),
+        });
+        lastSample = now;
+    }, options.sample);
+
+    // Generate arrivals ahead of time on the ideal schedule and release
+    // every arrival that is due whenever the loop gets a turn. If the loop
+    // is blocked, the backlog is released late but still timed from the
+    // moment it should have arrived.
+    let nextArrival = start;
+    await new Promise((resolve) => {
+        const tick = () => {
+            const now = performance.now();
+            while (nextArrival <= now && nextArrival < end) {
+                issue(nextArrival);
+                nextArrival += -Math.log(1 - Math.random()) * 1000 / rateAt(nextArrival);
+            }
+            if (nextArrival >= end) {
+                resolve();
+                return;
+            }
+            setTimeout(tick, Math.max(0, Math.min(5, nextArrival - now)));
+        };
+        tick();
+    });
+
+    await new Promise((resolve) => {
+        const poll = () => (inFlight === 0 ? resolve() : setTimeout(poll, 5));
+        poll();
+    });
+    clearInterval(sampler);
+    loopDelay.disable();
+
+    const elapsed = (performance.now() - start) / 1000;
+    const all = latencies.compare.concat(latencies.hash);
+    const result = {
+        options: { ...options },
+        threadpool: Number(process.env.UV_THREADPOOL_SIZE || 4),
+        elapsed,
+        offered: issued / options.duration,
+        throughput: all.length / elapsed,
+        errors,
+        latency: {
+            all: summarize(all),
+            compare: summarize(latencies.compare),
+            hash: summarize(latencies.hash),
+            byCost: Object.fromEntries([...byCost].map(([cost, l]) => [cost, summarize(l)])),
+        },
+        eventLoopDelay: {
+            min: loopDelay.min / 1e6,
+            mean: loopDelay.mean / 1e6,
+            p50: loopDelay.percentile(50) / 1e6,
+            p99: loopDelay.percentile(99) / 1e6,
+            max: loopDelay.max / 1e6,
+        },
+        timeline,
+    };
+
+    const json = JSON.stringify(result, null, 2);
+    if (options.out) {
+        fs.writeFileSync(options.out, json + '\n');
+    } else {
+        console.log(json);
+    }
+}
+
+main().catch((err) => {
+    console.error(err);
+    process.exit(1);
+});
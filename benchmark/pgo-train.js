@@ -0,0 +1,47 @@
+// Training workload for the profile-guided build (see build-pgo.sh).
+//
+// The profile should look like production traffic: mostly compares and
+// hashes at common costs, both minor versions, short and long passwords,
+// driven from the sync API and from the thread pool at the same time.
+
+const bcrypt = require('../bcrypt');
+
+const COSTS = [4, 6, 8, 10];
+const PASSWORDS = [
+    '',
+    'password',
+    'correct horse battery staple',
+    'ἓν οἶδα ὅτι οὐδὲν οἶδα',
+    Buffer.from('Passw\0rd with an embedded NUL'),
+    'x'.repeat(72),
+    'y'.repeat(100),
+];
+const ITERATIONS = Number.parseInt(process.env.PGO_ITERATIONS || '4', 10);
+
+async function train() {
+    for (let i = 0; i < ITERATIONS; i++) {
+        for (const cost of COSTS) {
+            for (const minor of ['a', 'b']) {
+                const salt = bcrypt.genSaltSync(cost, minor);
+                const pending = [];
+
+                for (const password of PASSWORDS) {
+                    const hash = bcrypt.hashSync(password, salt);
+                    bcrypt.compareSync(password, hash);
+                    bcrypt.compareSync('wrong', hash);
+
+                    pending.push(bcrypt.hash(password, salt)
+                        .then(hash => bcrypt.compare(password, hash)));
+                }
+
+                bcrypt.getRounds(bcrypt.hashSync('rounds', salt));
+                await Promise.all(pending);
+            }
+        }
+    }
+}
+
+train().catch((err) => {
+    console.error(err);
+    process.exit(1);
+});
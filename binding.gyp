@@ -1,23 +1,20 @@
 {
   "variables": {
-    "NODE_VERSION%":"<!(node -p \"process.versions.node.split(\\\".\\\")[0]\")"
+    "NODE_VERSION%":"<!(node -p \"process.versions.node.split(\\\".\\\")[0]\")",
+    # Optional optimized build profile, see build-pgo.sh:
+    #   node-gyp rebuild --bcrypt_optimize=true [--bcrypt_pgo=generate|use]
+    "bcrypt_optimize%": "false",
+    "bcrypt_pgo%": "",
+    "bcrypt_pgo_dir%": "<(module_root_dir)/build-pgo",
   },
-  'targets': [
-    {
-      'target_name': 'bcrypt_lib',
-      'sources': [
-        'src/blowfish.cc',
-        'src/bcrypt.cc',
-        'src/bcrypt_node.cc'
-      ],
+  # compiler settings shared by the addon, the static library and the CLI,
+  # so all of them get the same optimized build profile
+  'target_defaults': {
       'defines': [
             '_GNU_SOURCE',
       ],
       'cflags!': [ '-fno-exceptions' ],
       'cflags_cc!': [ '-fno-exceptions' ],
-      'dependencies': [
-          "<!(node -p \"require('node-addon-api').targets\"):node_addon_api_except",
-      ],
       'conditions': [
         ['OS=="win"', {
           "msvs_settings": {
@@ -37,6 +34,43 @@
             'GCC_SYMBOLS_PRIVATE_EXTERN': 'YES', # -fvisibility=hidden
           }
         }],
+        ['bcrypt_optimize=="true" and OS!="win"', {
+          'defines': [ 'BCRYPT_MULTIVERSION' ],
+          'cflags': [ '-O3', '-flto' ],
+          'ldflags': [ '-O3', '-flto' ],
+          'xcode_settings': {
+            'GCC_OPTIMIZATION_LEVEL': '3',
+            'LLVM_LTO': 'YES',
+          }
+        }],
+        ['bcrypt_optimize=="true" and OS=="win"', {
+          'msvs_settings': {
+            'VCCLCompilerTool': {
+              'Optimization': 2,
+              'WholeProgramOptimization': 'true',
+            },
+            'VCLinkerTool': {
+              'LinkTimeCodeGeneration': 1,
+            }
+          }
+        }],
+        # PGO is only wired up for GCC; the training workload lives in
+        # benchmark/pgo-train.js
+        ['bcrypt_pgo=="generate" and OS!="win" and OS!="mac"', {
+          'cflags': [
+            '-fprofile-generate=<(bcrypt_pgo_dir)',
+            '-fprofile-update=prefer-atomic',
+          ],
+          'ldflags': [ '-fprofile-generate=<(bcrypt_pgo_dir)' ],
+        }],
+        ['bcrypt_pgo=="use" and OS!="win" and OS!="mac"', {
+          'cflags': [
+            '-fprofile-use=<(bcrypt_pgo_dir)',
+            '-fprofile-correction',
+            '-Wno-missing-profile',
+          ],
+          'ldflags': [ '-fprofile-use=<(bcrypt_pgo_dir)' ],
+        }],
         ['OS=="zos" and NODE_VERSION <= 16',{
             'cflags': [
               '-qascii',
@@ -44,6 +78,48 @@
             'defines': ["NAPI_DISABLE_CPP_EXCEPTIONS"],
         }],
       ],
+  },
+  'targets': [
+    {
+      'target_name': 'bcrypt_lib',
+      'sources': [
+        'src/blowfish.cc',
+        'src/bcrypt.cc',
+        'src/bcrypt_pbkdf.cc',
+        'src/bcrypt_filter.cc',
+        'src/bcrypt_node.cc'
+      ],
+      'include_dirs': [ 'include' ],
+      'dependencies': [
+          "<!(node -p \"require('node-addon-api').targets\"):node_addon_api_except",
+      ],
+    },
+    # Standalone library for C and C++ programs, see include/bcrypt.h
+    {
+      'target_name': 'bcrypt_static',
+      'type': 'static_library',
+      'sources': [
+        'src/blowfish.cc',
+        'src/bcrypt.cc',
+        'src/bcrypt_api.cc',
+        'src/bcrypt_filter.cc'
+      ],
+      'include_dirs': [ 'include' ],
+      'direct_dependent_settings': {
+        'include_dirs': [ 'include' ],
+      },
+    },
+    {
+      'target_name': 'bcrypt_cli',
+      'product_name': 'bcrypt',
+      'type': 'executable',
+      'sources': [ 'src/bcrypt_cli.cc' ],
+      'dependencies': [ 'bcrypt_static' ],
+      'conditions': [
+        ['OS!="win"', {
+          'ldflags': [ '-pthread' ],
+        }],
+      ],
     },
   ]
 }
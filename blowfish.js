@@ -0,0 +1,120 @@
+const path = require('path');
+const bindings = require('node-gyp-build')(path.resolve(__dirname));
+
+const promises = require('./promises');
+
+// must match BlowfishMode in src/bcrypt_node.cc
+const ECB_ENCRYPT = 0;
+const ECB_DECRYPT = 1;
+const CBC_ENCRYPT = 2;
+const CBC_DECRYPT = 3;
+const CTR = 4;
+
+/// inputs at least this long are processed on the thread pool by the async
+/// methods; shorter ones are cheaper to process in place
+const DEFAULT_ASYNC_THRESHOLD = 64 * 1024;
+
+function toBuffer(value, name) {
+    if (typeof value === 'string') {
+        return Buffer.from(value);
+    }
+    if (!(value instanceof Buffer)) {
+        throw new Error(name + ' must be a string or Buffer');
+    }
+    return value;
+}
+
+/// Blowfish block cipher with a precomputed key schedule.
+///
+/// All methods work in place: `data` is overwritten and returned. ECB and
+/// CBC need a multiple of 8 bytes, CTR takes any length. `iv` is an 8 byte
+/// Buffer and is not updated. For CTR it is the initial value of a 64-bit
+/// big-endian block counter.
+class Blowfish {
+    /// @param {String|Buffer} key 1 to 72 bytes
+    /// @param {Object} [options]
+    /// @param {Number} [options.asyncThreshold] size in bytes from which the
+    ///     async methods use the thread pool (default 64 KiB)
+    constructor(key, options) {
+        this._cipher = new bindings.Blowfish(toBuffer(key, 'key'));
+        this.asyncThreshold = (options && options.asyncThreshold != null)
+            ? options.asyncThreshold
+            : DEFAULT_ASYNC_THRESHOLD;
+    }
+
+    encryptEcbSync(data) {
+        return this._cipher.crypt_sync(ECB_ENCRYPT, data, null);
+    }
+
+    decryptEcbSync(data) {
+        return this._cipher.crypt_sync(ECB_DECRYPT, data, null);
+    }
+
+    encryptCbcSync(data, iv) {
+        return this._cipher.crypt_sync(CBC_ENCRYPT, data, iv);
+    }
+
+    decryptCbcSync(data, iv) {
+        return this._cipher.crypt_sync(CBC_DECRYPT, data, iv);
+    }
+
+    ctrSync(data, iv) {
+        return this._cipher.crypt_sync(CTR, data, iv);
+    }
+
+    encryptEcb(data, cb) {
+        return this._crypt(ECB_ENCRYPT, data, null, cb);
+    }
+
+    decryptEcb(data, cb) {
+        return this._crypt(ECB_DECRYPT, data, null, cb);
+    }
+
+    encryptCbc(data, iv, cb) {
+        return this._crypt(CBC_ENCRYPT, data, iv, cb);
+    }
+
+    decryptCbc(data, iv, cb) {
+        return this._crypt(CBC_DECRYPT, data, iv, cb);
+    }
+
+    ctr(data, iv, cb) {
+        return this._crypt(CTR, data, iv, cb);
+    }
+
+    _crypt(mode, data, iv, cb) {
+        // cb exists but is not a function
+        // return a rejecting promise
+        if (cb && typeof cb !== 'function') {
+            return promises.reject(new Error('cb must be a function or null to return a Promise'));
+        }
+
+        if (!cb) {
+            return promises.promise(this._crypt, this, [mode, data, iv]);
+        }
+
+        if (data instanceof Buffer && data.length >= this.asyncThreshold) {
+            try {
+                return this._cipher.crypt(mode, data, iv, cb);
+            } catch (err) {
+                return process.nextTick(function () {
+                    cb(err);
+                });
+            }
+        }
+
+        let result;
+        try {
+            result = this._cipher.crypt_sync(mode, data, iv);
+        } catch (err) {
+            return process.nextTick(function () {
+                cb(err);
+            });
+        }
+        process.nextTick(function () {
+            cb(undefined, result);
+        });
+    }
+}
+
+module.exports = Blowfish;
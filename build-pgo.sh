@@ -0,0 +1,32 @@
+#!/bin/bash -ue
+#
+# Profile-guided, multiversioned build of bcrypt_lib.
+#
+# 1. build an instrumented binary
+# 2. run benchmark/pgo-train.js to collect a profile
+# 3. rebuild with the profile applied
+#
+# Set PREBUILD=true to produce the final binary with prebuildify instead of
+# node-gyp. Requires GCC; see the bcrypt_* variables in binding.gyp.
+
+PGO_DIR=${PGO_DIR:-"$PWD/build-pgo"}
+PREBUILD=${PREBUILD:-""}
+
+export npm_config_bcrypt_optimize=true
+export npm_config_bcrypt_pgo_dir="$PGO_DIR"
+
+rm -rf "$PGO_DIR"
+
+echo -- instrumented build --
+npm_config_bcrypt_pgo=generate npx node-gyp rebuild
+
+echo -- training --
+node benchmark/pgo-train.js
+
+echo -- optimized build --
+export npm_config_bcrypt_pgo=use
+if [ -n "$PREBUILD" ]; then
+  npm run build
+else
+  npx node-gyp rebuild
+fi
@@ -0,0 +1,132 @@
+/*
+ * Standalone bcrypt library, built from the same sources as the node
+ * addon by the bcrypt_static target in binding.gyp.
+ *
+ * Every function writes to buffers owned by the caller and keeps no state,
+ * so all of them may be called from any number of threads at once.
+ */
+
+#ifndef BCRYPT_H_
+#define BCRYPT_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BCRYPT_SALT_SIZE 30	/* "$2b$10$" + 22 characters + NUL */
+#define BCRYPT_HASH_SIZE 64	/* 60 characters + NUL, rounded up */
+#define BCRYPT_SEED_SIZE 16	/* random bytes per salt */
+
+#define BCRYPT_OK 0
+#define BCRYPT_EINVAL (-1)	/* malformed salt, hash or arguments */
+#define BCRYPT_ERANDOM (-2)	/* the system random source failed */
+
+/*
+ * Encodes a salt for minor version 'a' or 'b' and cost 4 to 31 from
+ * BCRYPT_SEED_SIZE random bytes supplied by the caller.
+ */
+int bcrypt_salt(char minor, int cost, const unsigned char *seed, char *salt);
+
+/* Same as bcrypt_salt, seeded from the system random source. */
+int bcrypt_salt_random(char minor, int cost, char *salt);
+
+/*
+ * Hashes password with salt, which may also be a full hash. Only the first
+ * 72 bytes of password are used. Writes a NUL terminated hash of at most
+ * BCRYPT_HASH_SIZE bytes.
+ */
+int bcrypt_hashpw(const char *password, size_t password_len,
+    const char *salt, char *hash);
+
+/*
+ * Returns 1 if password matches hash, 0 if it does not and BCRYPT_EINVAL
+ * if hash is malformed. The final comparison takes constant time.
+ */
+int bcrypt_checkpw(const char *password, size_t password_len,
+    const char *hash);
+
+/*
+ * One entry of a batch. For bcrypt_hashpw_batch, salt is the input and the
+ * hash is written to hash. For bcrypt_checkpw_batch, salt holds the hash to
+ * check against and hash is left alone. result receives what the single
+ * call would have returned.
+ */
+typedef struct bcrypt_job {
+	const char *password;
+	size_t password_len;
+	const char *salt;
+	char hash[BCRYPT_HASH_SIZE];
+	int result;
+} bcrypt_job;
+
+/*
+ * Runs count jobs on up to threads threads, the calling thread included.
+ * threads 0 uses one thread per CPU. Returns BCRYPT_OK once every job has
+ * run, whatever their individual results, or BCRYPT_EINVAL if jobs is NULL.
+ */
+int bcrypt_hashpw_batch(bcrypt_job *jobs, size_t count, unsigned int threads);
+int bcrypt_checkpw_batch(bcrypt_job *jobs, size_t count, unsigned int threads);
+
+/*
+ * Breached password filter: a blocked Bloom filter over the SHA-1 digests
+ * of breached passwords, as published in SHA-1 lists. A file holds a
+ * BCRYPT_FILTER_HEADER_SIZE byte header followed by the blocks, each one
+ * cache line of BCRYPT_FILTER_BLOCK_SIZE bytes, so a lookup touches a
+ * single line of a file that can be memory-mapped and shared by every
+ * process on a host. The header is "BCRYPTBF", then little endian u32
+ * version (1), u32 hashes per entry, u64 blocks, u64 entries and u32 bits
+ * per entry, zero padded.
+ *
+ * A test never misses a digest that was added, and reports one that was
+ * not with a probability set by the bits per entry: about 1% at 10 and
+ * 0.1% at 16.
+ */
+#define BCRYPT_FILTER_HEADER_SIZE 64
+#define BCRYPT_FILTER_BLOCK_SIZE 64
+#define BCRYPT_SHA1_SIZE 20
+
+typedef struct bcrypt_filter {
+	unsigned char *blocks;
+	unsigned long long block_count;
+	unsigned long long entries;
+	unsigned int hashes;		/* bits set per entry */
+	unsigned int bits_per_entry;
+} bcrypt_filter;
+
+/*
+ * Size in bytes of a filter file for entries digests at bits_per_entry
+ * bits each (4 to 64), or 0 if either is out of range.
+ */
+size_t bcrypt_filter_size(unsigned long long entries,
+    unsigned int bits_per_entry);
+
+/*
+ * Sets up an empty filter in the bcrypt_filter_size bytes at data, writing
+ * the header and zeroing the blocks.
+ */
+int bcrypt_filter_create(bcrypt_filter *filter, unsigned long long entries,
+    unsigned int bits_per_entry, void *data, size_t size);
+
+/*
+ * Reads the header of a filter file of size bytes at data, e.g. a read-only
+ * mapping, which must stay valid while the filter is used. Returns
+ * BCRYPT_EINVAL if it is not a filter file or is truncated. Replace a
+ * filter file that may be mapped by renaming a new file over it, never by
+ * rewriting it in place; readers see the new file once they open it again.
+ */
+int bcrypt_filter_open(bcrypt_filter *filter, const void *data, size_t size);
+
+/* Adds a SHA-1 digest to a filter set up by bcrypt_filter_create. */
+void bcrypt_filter_add(bcrypt_filter *filter, const unsigned char *sha1);
+
+/* Returns 1 if the SHA-1 digest may be in the filter and 0 if it is not. */
+int bcrypt_filter_test(const bcrypt_filter *filter,
+    const unsigned char *sha1);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -145,84 +145,86 @@ bcrypt_gensalt(char minor, u_int8_t log_rounds, u_int8_t *seed, char *gsalt)
 /* We handle $Vers$log2(NumRounds)$salt+passwd$
    i.e. $2$04$iwouldntknowwhattosayetKdJ6iFtacBqJdKe6aW7ou */
 
-void
-bcrypt(const char *key, size_t key_len, const char *salt, char *encrypted)
+/* Parses the $Vers$log2(NumRounds)$salt prefix into its minor version
+   (0 for none), log2 rounds and raw salt. Returns 0 on success. */
+int
+bcrypt_parse_salt(const char *salt, u_int8_t *minor, u_int8_t *logr,
+    u_int8_t *csalt)
 {
-	blf_ctx state;
-	u_int32_t rounds, i, k;
-	u_int16_t j;
-	u_int8_t salt_len, logr, minor;
-	u_int8_t ciphertext[4 * BCRYPT_BLOCKS+1] = "OrpheanBeholderScryDoubt";
-	u_int8_t csalt[BCRYPT_MAXSALT];
-	u_int32_t cdata[BCRYPT_BLOCKS];
 	int n;
 
 	/* Discard "$" identifier */
 	salt++;
 
-	if (*salt > BCRYPT_VERSION) {
-		/* How do I handle errors ? Return ':' */
-		strcpy(encrypted, error);
-		return;
-	}
+	if (*salt > BCRYPT_VERSION)
+		return -1;
 
 	/* Check for minor versions */
 	if (salt[1] != '$') {
 		 switch (salt[1]) {
 		 case 'a': /* 'ab' should not yield the same as 'abab' */
 		 case 'b': /* cap input length at 72 bytes */
-			 minor = salt[1];
+			 *minor = salt[1];
 			 salt++;
 			 break;
 		 default:
-			 strcpy(encrypted, error);
-			 return;
+			 return -1;
 		 }
 	} else
-		 minor = 0;
+		 *minor = 0;
 
 	/* Discard version + "$" identifier */
 	salt += 2;
 
-	if (salt[2] != '$') {
+	if (salt[2] != '$')
 		/* Out of sync with passwd entry */
-		strcpy(encrypted, error);
-		return;
-	}
+		return -1;
 
 	/* Computer power doesn't increase linear, 2^x should be fine */
 	n = atoi(salt);
-	if (n > 31 || n < 0) {
-		strcpy(encrypted, error);
-		return;
-	}
-	logr = (u_int8_t)n;
-	if ((rounds = (u_int32_t) 1 << logr) < BCRYPT_MINROUNDS) {
-		strcpy(encrypted, error);
-		return;
-	}
+	if (n > 31 || n < 0)
+		return -1;
+	*logr = (u_int8_t)n;
+	if (((u_int32_t) 1 << *logr) < BCRYPT_MINROUNDS)
+		return -1;
 
 	/* Discard num rounds + "$" identifier */
 	salt += 3;
 
-	if (strlen(salt) * 3 / 4 < BCRYPT_MAXSALT) {
-		strcpy(encrypted, error);
-		return;
-	}
+	if (strlen(salt) * 3 / 4 < BCRYPT_MAXSALT)
+		return -1;
 
 	/* We dont want the base64 salt but the raw data */
 	decode_base64(csalt, BCRYPT_MAXSALT, (u_int8_t *) salt);
-	salt_len = BCRYPT_MAXSALT;
+	return 0;
+}
+
+/* Effective key length: $2a$ and $2b$ include the NUL, and $2b$ caps the
+   key at 72 bytes first to avoid the integer wraparound of $2a$. */
+static size_t
+bcrypt_key_len(size_t key_len, u_int8_t minor)
+{
 	if (minor <= 'a')
-		key_len = (u_int8_t)(key_len + (minor >= 'a' ? 1 : 0));
-	else
-	{
-		/* cap key_len at the actual maximum supported
-		* length here to avoid integer wraparound */
-		if (key_len > 72)
-			key_len = 72;
-		key_len++; /* include the NUL */
-	}
+		return (u_int8_t)(key_len + (minor >= 'a' ? 1 : 0));
+	return (key_len > 72 ? 72 : key_len) + 1;
+}
+
+/* The bcrypt core: computes the raw BCRYPT_DIGEST_LEN byte digest from a
+   parsed salt, without any base64 on either side. */
+BLF_MULTIVERSION void
+bcrypt_raw(const char *key, size_t key_len, u_int8_t minor, u_int8_t logr,
+    const u_int8_t *csalt, u_int8_t *digest)
+{
+	blf_ctx state;
+	u_int32_t rounds, i, k;
+	u_int16_t j;
+	u_int8_t salt_len;
+	u_int8_t ciphertext[4 * BCRYPT_BLOCKS+1] = "OrpheanBeholderScryDoubt";
+	u_int32_t cdata[BCRYPT_BLOCKS];
+
+	rounds = (u_int32_t) 1 << logr;
+	salt_len = BCRYPT_MAXSALT;
+	key_len = bcrypt_key_len(key_len, minor);
 
 
 	/* Setting up S-Boxes and Subkeys */
@@ -253,6 +255,28 @@ bcrypt(const char *key, size_t key_len, const char *salt, char *encrypted)
 		ciphertext[4 * i + 0] = cdata[i] & 0xff;
 	}
 
+	memcpy(digest, ciphertext, BCRYPT_DIGEST_LEN);
+	memset(&state, 0, sizeof(state));
+	memset(ciphertext, 0, sizeof(ciphertext));
+	memset(cdata, 0, sizeof(cdata));
+}
+
+void
+bcrypt(const char *key, size_t key_len, const char *salt, char *encrypted)
+{
+	u_int8_t csalt[BCRYPT_MAXSALT];
+	u_int8_t digest[BCRYPT_DIGEST_LEN];
+	u_int8_t minor, logr;
+	u_int32_t i;
+
+	if (bcrypt_parse_salt(salt, &minor, &logr, csalt) != 0) {
+		/* How do I handle errors ? Return ':' */
+		strcpy(encrypted, error);
+		return;
+	}
+
+	bcrypt_raw(key, key_len, minor, logr, csalt, digest);
+
 	i = 0;
 	encrypted[i++] = '$';
 	encrypted[i++] = BCRYPT_VERSION;
@@ -263,14 +287,283 @@ bcrypt(const char *key, size_t key_len, const char *salt, char *encrypted)
 	snprintf(encrypted + i, 4, "%2.2u$", logr & 0x001F);
 
 	encode_base64((u_int8_t *) encrypted + i + 3, csalt, BCRYPT_MAXSALT);
-	encode_base64((u_int8_t *) encrypted + strlen(encrypted), ciphertext,
-		4 * BCRYPT_BLOCKS - 1);
-	memset(&state, 0, sizeof(state));
-	memset(ciphertext, 0, sizeof(ciphertext));
+	encode_base64((u_int8_t *) encrypted + strlen(encrypted), digest,
+		BCRYPT_DIGEST_LEN);
+	memset(digest, 0, sizeof(digest));
 	memset(csalt, 0, sizeof(csalt));
+}
+
+/* Binary hash form, BCRYPT_BINARY_LEN bytes:
+ *   0      version: 0x2a for $2a$, 0x2b for $2b$, 0x20 for $2$
+ *   1      log2 rounds
+ *   2-17   raw salt
+ *   18-40  raw digest
+ */
+
+static u_int8_t
+binary_version(u_int8_t minor)
+{
+	return (BCRYPT_VERSION - '0') << 4 | (minor ? minor - 'a' + 0xa : 0);
+}
+
+static int
+binary_minor(u_int8_t version, u_int8_t *minor)
+{
+	switch (version) {
+	case 0x20:
+		*minor = 0;
+		return 0;
+	case 0x2a:
+	case 0x2b:
+		*minor = 'a' + (version & 0x0f) - 0xa;
+		return 0;
+	default:
+		return -1;
+	}
+}
+
+/* Hashes key with a salt string straight into the binary form. Returns 0 on
+   success, -1 if the salt is invalid. */
+int
+bcrypt_binary(const char *key, size_t key_len, const char *salt, u_int8_t *bin)
+{
+	u_int8_t minor, logr;
+
+	if (bcrypt_parse_salt(salt, &minor, &logr, bin + 2) != 0)
+		return -1;
+	bin[0] = binary_version(minor);
+	bin[1] = logr;
+	bcrypt_raw(key, key_len, minor, logr, bin + 2, bin + 2 + BCRYPT_MAXSALT);
+	return 0;
+}
+
+/* Compares two digests in time independent of where they differ. */
+static int
+bcrypt_digest_equal(const u_int8_t *a, const u_int8_t *b)
+{
+	u_int8_t diff = 0;
+	size_t i;
+
+	for (i = 0; i < BCRYPT_DIGEST_LEN; i++)
+		diff |= a[i] ^ b[i];
+	return diff == 0;
+}
+
+/* Recomputes the digest of key for a binary hash and compares. Returns 1 on
+   a match and 0 on a mismatch or a malformed binary hash. */
+int
+bcrypt_binary_compare(const char *key, size_t key_len, const u_int8_t *bin)
+{
+	u_int8_t minor;
+	u_int8_t digest[BCRYPT_DIGEST_LEN];
+	int match;
+
+	if (binary_minor(bin[0], &minor) != 0 || bin[1] > 31 ||
+	    ((u_int32_t) 1 << bin[1]) < BCRYPT_MINROUNDS)
+		return 0;
+	bcrypt_raw(key, key_len, minor, bin[1], bin + 2, digest);
+	match = bcrypt_digest_equal(digest, bin + 2 + BCRYPT_MAXSALT);
+	memset(digest, 0, sizeof(digest));
+	return match;
+}
+
+/* bcrypt_raw for BLF_LANES keys under one salt, with the key schedules of
+   the lanes interleaved. */
+BLF_MULTIVERSION static void
+bcrypt_raw_lanes(const char *const *keys, const size_t *key_lens,
+    u_int8_t minor, u_int8_t logr, const u_int8_t *csalt,
+    u_int8_t (*digests)[BCRYPT_DIGEST_LEN])
+{
+	blf_ctx state[BLF_LANES];
+	const u_int8_t *key[BLF_LANES], *salt[BLF_LANES];
+	u_int16_t keybytes[BLF_LANES], saltbytes[BLF_LANES];
+	u_int8_t ciphertext[4 * BCRYPT_BLOCKS+1];
+	u_int32_t cdata[BCRYPT_BLOCKS];
+	u_int32_t rounds, i, k;
+	u_int16_t j;
+	int n;
+
+	rounds = (u_int32_t) 1 << logr;
+	for (n = 0; n < BLF_LANES; n++) {
+		key[n] = (const u_int8_t *) keys[n];
+		keybytes[n] = (u_int16_t) bcrypt_key_len(key_lens[n], minor);
+		salt[n] = csalt;
+		saltbytes[n] = BCRYPT_MAXSALT;
+		Blowfish_initstate(&state[n]);
+	}
+
+	Blowfish_expandstate_lanes(state, csalt, BCRYPT_MAXSALT, key, keybytes);
+	for (k = 0; k < rounds; k++) {
+		Blowfish_expand0state_lanes(state, key, keybytes);
+		Blowfish_expand0state_lanes(state, salt, saltbytes);
+	}
+
+	for (n = 0; n < BLF_LANES; n++) {
+		memcpy(ciphertext, "OrpheanBeholderScryDoubt", sizeof(ciphertext));
+		j = 0;
+		for (i = 0; i < BCRYPT_BLOCKS; i++)
+			cdata[i] = Blowfish_stream2word(ciphertext,
+			    4 * BCRYPT_BLOCKS, &j);
+		for (k = 0; k < 64; k++)
+			blf_enc(&state[n], cdata, BCRYPT_BLOCKS / 2);
+		for (i = 0; i < BCRYPT_BLOCKS; i++) {
+			ciphertext[4 * i + 0] = cdata[i] >> 24 & 0xff;
+			ciphertext[4 * i + 1] = cdata[i] >> 16 & 0xff;
+			ciphertext[4 * i + 2] = cdata[i] >> 8 & 0xff;
+			ciphertext[4 * i + 3] = cdata[i] & 0xff;
+		}
+		memcpy(digests[n], ciphertext, BCRYPT_DIGEST_LEN);
+	}
+
+	memset(state, 0, sizeof(state));
+	memset(ciphertext, 0, sizeof(ciphertext));
 	memset(cdata, 0, sizeof(cdata));
 }
 
+/* Compares count keys against one binary hash and returns the index of the
+   first key that matches, or -1 if none does or the binary hash is
+   malformed. Keys after a match are not hashed. The first key, usually the
+   one that matches, runs alone; the rest run BLF_LANES at a time while at
+   least 3 are left, below which padding a group costs more than the
+   interleaving saves. */
+int
+bcrypt_compare_any(const char *const *keys, const size_t *key_lens,
+    size_t count, const u_int8_t *bin)
+{
+	const char *lane_keys[BLF_LANES];
+	size_t lane_lens[BLF_LANES];
+	u_int8_t digests[BLF_LANES][BCRYPT_DIGEST_LEN];
+	u_int8_t minor;
+	const u_int8_t *csalt = bin + 2, *expected = bin + 2 + BCRYPT_MAXSALT;
+	size_t base, m, n;
+	int match = -1;
+
+	if (binary_minor(bin[0], &minor) != 0 || bin[1] > 31 ||
+	    ((u_int32_t) 1 << bin[1]) < BCRYPT_MINROUNDS)
+		return -1;
+
+	for (base = 0; base < count && match < 0; base += m) {
+		m = count - base;
+		if (base == 0 || m < 3)
+			m = 1;
+		else if (m > BLF_LANES)
+			m = BLF_LANES;
+		if (m == 1) {
+			bcrypt_raw(keys[base], key_lens[base], minor, bin[1],
+			    csalt, digests[0]);
+		} else {
+			/* pad a short group with its last key */
+			for (n = 0; n < BLF_LANES; n++) {
+				lane_keys[n] = keys[base + (n < m ? n : m - 1)];
+				lane_lens[n] = key_lens[base + (n < m ? n : m - 1)];
+			}
+			bcrypt_raw_lanes(lane_keys, lane_lens, minor, bin[1],
+			    csalt, digests);
+		}
+		for (n = 0; n < m; n++) {
+			if (bcrypt_digest_equal(digests[n], expected)) {
+				match = (int) (base + n);
+				break;
+			}
+		}
+	}
+	memset(digests, 0, sizeof(digests));
+	return match;
+}
+
+/* Strictly checks that hash is a complete $2$, $2a$ or $2b$ hash with a two
+   digit cost and 53 base64 characters, and returns its minor version and
+   log2 rounds. The unused low bits of the last salt and digest characters
+   must be zero: bcrypt() never produces anything else, so a hash spelled
+   otherwise can never match in compare and must not match in binary form
+   either. Returns 0 if it is well-formed and -1 otherwise. */
+int
+bcrypt_check_hash(const char *hash, u_int8_t *minor, u_int8_t *logr)
+{
+	const char *p = hash;
+	size_t i;
+	int n;
+
+	if (!p || p[0] != '$' || p[1] != BCRYPT_VERSION)
+		return -1;
+	p += 2;
+
+	if (*p == 'a' || *p == 'b')
+		*minor = *p++;
+	else
+		*minor = 0;
+	if (*p++ != '$')
+		return -1;
+
+	if (p[0] < '0' || p[0] > '9' || p[1] < '0' || p[1] > '9' || p[2] != '$')
+		return -1;
+	n = (p[0] - '0') * 10 + (p[1] - '0');
+	if (n > 31 || ((u_int32_t) 1 << n) < BCRYPT_MINROUNDS)
+		return -1;
+	*logr = (u_int8_t) n;
+	p += 3;
+
+	for (i = 0; i < BCRYPT_ENCODED_LEN; i++)
+		if (p[i] == '\0' || CHAR64((u_int8_t) p[i]) == 255)
+			return -1;
+	if (p[BCRYPT_ENCODED_LEN] != '\0')
+		return -1;
+	/* 22 characters carry 132 bits for 128 of salt, 31 carry 186 for 184 */
+	if ((CHAR64((u_int8_t) p[BCRYPT_SALT_ENCODED_LEN - 1]) & 0x0f) != 0 ||
+	    (CHAR64((u_int8_t) p[BCRYPT_ENCODED_LEN - 1]) & 0x03) != 0)
+		return -1;
+	return 0;
+}
+
+/* Converts a full hash string to the binary form. Returns 0 on success and
+   -1 if hash is not a well-formed bcrypt hash. */
+int
+bcrypt_to_binary(const char *hash, u_int8_t *bin)
+{
+	const char *p;
+	u_int8_t minor, logr;
+
+	if (bcrypt_check_hash(hash, &minor, &logr) != 0)
+		return -1;
+
+	/* $2$NN$ or $2x$NN$, then 22 salt and 31 digest characters */
+	p = hash + (minor ? 7 : 6);
+	bin[0] = binary_version(minor);
+	bin[1] = logr;
+	decode_base64(bin + 2, BCRYPT_MAXSALT, (u_int8_t *) p);
+	decode_base64(bin + 2 + BCRYPT_MAXSALT, BCRYPT_DIGEST_LEN,
+	    (u_int8_t *) p + BCRYPT_SALT_ENCODED_LEN);
+	return 0;
+}
+
+/* Converts the binary form back to a hash string of at most
+   _PASSWORD_LEN characters. Returns -1 if bin is malformed. */
+int
+bcrypt_from_binary(const u_int8_t *bin, char *hash)
+{
+	u_int8_t minor;
+	u_int32_t i;
+
+	if (binary_minor(bin[0], &minor) != 0 || bin[1] > 31 ||
+	    ((u_int32_t) 1 << bin[1]) < BCRYPT_MINROUNDS)
+		return -1;
+
+	i = 0;
+	hash[i++] = '$';
+	hash[i++] = BCRYPT_VERSION;
+	if (minor)
+		hash[i++] = minor;
+	hash[i++] = '$';
+
+	snprintf(hash + i, 4, "%2.2u$", bin[1] & 0x001F);
+
+	encode_base64((u_int8_t *) hash + i + 3, (u_int8_t *) bin + 2,
+	    BCRYPT_MAXSALT);
+	encode_base64((u_int8_t *) hash + strlen(hash),
+	    (u_int8_t *) bin + 2 + BCRYPT_MAXSALT, BCRYPT_DIGEST_LEN);
+	return 0;
+}
+
 u_int32_t bcrypt_get_rounds(const char * hash)
 {
   /* skip past the leading "$" */
@@ -0,0 +1,215 @@
+// Public C API of the standalone library, see include/bcrypt.h.
+
+#ifdef _WIN32
+#define _CRT_RAND_S
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__)
+#define BCRYPT_HAVE_ARC4RANDOM
+#elif defined(__linux__) && defined(__has_include)
+#if __has_include(<sys/random.h>)
+#define BCRYPT_HAVE_GETRANDOM
+#include <errno.h>
+#include <sys/random.h>
+#endif
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "node_blf.h"
+#include "bcrypt.h"
+
+namespace {
+
+#if !defined(_WIN32) && !defined(BCRYPT_HAVE_ARC4RANDOM)
+    // Reads the device only where the kernel has no random syscall, or an
+    // old kernel does not implement it.
+    int ReadUrandom(unsigned char* buf, size_t len) {
+        FILE* f = fopen("/dev/urandom", "rb");
+        if (!f) {
+            return BCRYPT_ERANDOM;
+        }
+        size_t n = fread(buf, 1, len, f);
+        fclose(f);
+        return n == len ? BCRYPT_OK : BCRYPT_ERANDOM;
+    }
+#endif
+
+    int FillRandom(unsigned char* buf, size_t len) {
+#if defined(_WIN32)
+        for (size_t i = 0; i < len; i += sizeof(unsigned int)) {
+            unsigned int r;
+            if (rand_s(&r) != 0) {
+                return BCRYPT_ERANDOM;
+            }
+            memcpy(buf + i, &r, std::min(len - i, sizeof(r)));
+        }
+        return BCRYPT_OK;
+#elif defined(BCRYPT_HAVE_ARC4RANDOM)
+        arc4random_buf(buf, len);
+        return BCRYPT_OK;
+#elif defined(BCRYPT_HAVE_GETRANDOM)
+        size_t done = 0;
+        while (done < len) {
+            ssize_t n = getrandom(buf + done, len - done, 0);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return errno == ENOSYS ? ReadUrandom(buf, len) : BCRYPT_ERANDOM;
+            }
+            done += (size_t) n;
+        }
+        return BCRYPT_OK;
+#else
+        return ReadUrandom(buf, len);
+#endif
+    }
+
+    // Rejects what ValidateSalt in bcrypt_node.cc rejects, plus anything
+    // that could not fit the output buffer.
+    bool ValidSalt(const char* salt) {
+        u_int8_t minor, logr;
+        u_int8_t csalt[BCRYPT_MAXSALT];
+        if (!salt || salt[0] != '$' || strlen(salt) > _PASSWORD_LEN) {
+            return false;
+        }
+        bool valid = bcrypt_parse_salt(salt, &minor, &logr, csalt) == 0;
+        memset(csalt, 0, sizeof(csalt));
+        return valid;
+    }
+
+    int HashJob(bcrypt_job* job) {
+        return bcrypt_hashpw(job->password, job->password_len, job->salt, job->hash);
+    }
+
+    int CheckJob(bcrypt_job* job) {
+        return bcrypt_checkpw(job->password, job->password_len, job->salt);
+    }
+
+    // Hands jobs out one at a time from a shared counter, so a thread that
+    // draws cheap jobs simply takes more of them.
+    void RunBatch(bcrypt_job* jobs, size_t count, unsigned int threads, int (*run)(bcrypt_job*)) {
+        std::atomic<size_t> next(0);
+        auto work = [&]() {
+            size_t i;
+            while ((i = next.fetch_add(1, std::memory_order_relaxed)) < count) {
+                jobs[i].result = run(&jobs[i]);
+            }
+        };
+
+        size_t n = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+        n = std::min(n, count);
+        std::vector<std::thread> workers;
+        for (size_t i = 1; i < n; i++) {
+            try {
+                workers.emplace_back(work);
+            } catch (const std::system_error&) {
+                // run with the threads we have
+                break;
+            }
+        }
+        work();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+
+} // anonymous namespace
+
+extern "C" {
+
+int
+bcrypt_salt(char minor, int cost, const unsigned char *seed, char *salt)
+{
+    if ((minor != 'a' && minor != 'b') || cost < 4 || cost > 31 || !seed || !salt) {
+        return BCRYPT_EINVAL;
+    }
+    u_int8_t copy[BCRYPT_MAXSALT];
+    memcpy(copy, seed, sizeof(copy));
+    bcrypt_gensalt(minor, (u_int8_t) cost, copy, salt);
+    memset(copy, 0, sizeof(copy));
+    return BCRYPT_OK;
+}
+
+int
+bcrypt_salt_random(char minor, int cost, char *salt)
+{
+    unsigned char seed[BCRYPT_SEED_SIZE];
+    int status = FillRandom(seed, sizeof(seed));
+    if (status == BCRYPT_OK) {
+        status = bcrypt_salt(minor, cost, seed, salt);
+    }
+    memset(seed, 0, sizeof(seed));
+    return status;
+}
+
+int
+bcrypt_hashpw(const char *password, size_t password_len, const char *salt, char *hash)
+{
+    if (!password || !hash || !ValidSalt(salt)) {
+        return BCRYPT_EINVAL;
+    }
+    char key[BLF_MAXUTILIZED + 1];
+    size_t n = std::min(password_len, (size_t) BLF_MAXUTILIZED);
+    memcpy(key, password, n);
+    key[n] = '\0';
+
+    char out[_PASSWORD_LEN];
+    bcrypt(key, password_len, salt, out);
+    memset(key, 0, sizeof(key));
+    if (strlen(out) >= BCRYPT_HASH_SIZE) {
+        return BCRYPT_EINVAL;
+    }
+    strcpy(hash, out);
+    return BCRYPT_OK;
+}
+
+int
+bcrypt_checkpw(const char *password, size_t password_len, const char *hash)
+{
+    char computed[BCRYPT_HASH_SIZE];
+    int status = bcrypt_hashpw(password, password_len, hash, computed);
+    if (status != BCRYPT_OK) {
+        return status;
+    }
+    size_t len = strlen(computed);
+    if (strlen(hash) != len) {
+        return 0;
+    }
+    unsigned char diff = 0;
+    for (size_t i = 0; i < len; i++) {
+        diff |= (unsigned char) (computed[i] ^ hash[i]);
+    }
+    return diff == 0;
+}
+
+int
+bcrypt_hashpw_batch(bcrypt_job *jobs, size_t count, unsigned int threads)
+{
+    if (!jobs && count) {
+        return BCRYPT_EINVAL;
+    }
+    RunBatch(jobs, count, threads, HashJob);
+    return BCRYPT_OK;
+}
+
+int
+bcrypt_checkpw_batch(bcrypt_job *jobs, size_t count, unsigned int threads)
+{
+    if (!jobs && count) {
+        return BCRYPT_EINVAL;
+    }
+    RunBatch(jobs, count, threads, CheckJob);
+    return BCRYPT_OK;
+}
+
+} // extern "C"
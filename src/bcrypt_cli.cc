@@ -0,0 +1,320 @@
+// bcrypt command line tool over the standalone library.
+//
+//   bcrypt hash [-c cost] [-m a|b] [-t threads]
+//       reads one password per line, writes one hash per line
+//   bcrypt verify [-t threads]
+//       reads "<hash> <password>" per line (hash, one space or tab, and the
+//       rest of the line), writes "ok", "mismatch" or "invalid" per line;
+//       exits with 1 if any line did not verify
+//   bcrypt filter [-b bits] <output> <input>...
+//       builds a breached password filter from SHA-1 lists, one hex digest
+//       per line, optionally followed by ":<count>" as in published lists,
+//       at bits (default 16) bits per digest; output is replaced by
+//       renaming, so processes that have it loaded are not disturbed
+//
+// Line endings are stripped, "\r\n" included. Lines are processed in
+// batches, so output order matches input order.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <string>
+#include <vector>
+
+#include "bcrypt.h"
+
+namespace {
+
+    const size_t kBatch = 4096;
+
+    void Usage() {
+        fprintf(stderr,
+            "usage: bcrypt hash [-c cost] [-m a|b] [-t threads]\n"
+            "       bcrypt verify [-t threads]\n"
+            "       bcrypt filter [-b bits] <output> <input>...\n");
+        exit(2);
+    }
+
+    bool ReadLine(std::string* line) {
+        line->clear();
+        int c;
+        while ((c = getc(stdin)) != EOF) {
+            if (c == '\n') {
+                break;
+            }
+            line->push_back((char) c);
+        }
+        if (c == EOF && line->empty()) {
+            return false;
+        }
+        if (!line->empty() && (*line)[line->size() - 1] == '\r') {
+            line->erase(line->size() - 1);
+        }
+        return true;
+    }
+
+    void Wipe(std::vector<std::string>& lines) {
+        for (std::string& line : lines) {
+            if (!line.empty()) {
+                memset(&line[0], 0, line.size());
+            }
+        }
+        lines.clear();
+    }
+
+    int Hash(int cost, char minor, unsigned int threads) {
+        std::vector<std::string> lines;
+        std::vector<bcrypt_job> jobs;
+        std::vector<std::string> salts;
+        std::string line;
+        bool more = true;
+        while (more) {
+            while (lines.size() < kBatch && (more = ReadLine(&line))) {
+                lines.push_back(line);
+            }
+            if (!line.empty()) {
+                memset(&line[0], 0, line.size());
+            }
+            jobs.assign(lines.size(), bcrypt_job());
+            salts.assign(lines.size(), std::string());
+            for (size_t i = 0; i < lines.size(); i++) {
+                char salt[BCRYPT_SALT_SIZE];
+                if (bcrypt_salt_random(minor, cost, salt) != BCRYPT_OK) {
+                    fprintf(stderr, "bcrypt: could not read the system random source\n");
+                    return 1;
+                }
+                salts[i] = salt;
+                jobs[i].password = lines[i].data();
+                jobs[i].password_len = lines[i].size();
+                jobs[i].salt = salts[i].c_str();
+            }
+            bcrypt_hashpw_batch(jobs.data(), jobs.size(), threads);
+            for (const bcrypt_job& job : jobs) {
+                puts(job.hash);
+            }
+            Wipe(lines);
+        }
+        return fflush(stdout) == 0 ? 0 : 1;
+    }
+
+    int Verify(unsigned int threads) {
+        std::vector<std::string> lines;
+        std::vector<bcrypt_job> jobs;
+        std::vector<std::string> hashes;
+        std::string line;
+        bool more = true;
+        int status = 0;
+        while (more) {
+            while (lines.size() < kBatch && (more = ReadLine(&line))) {
+                lines.push_back(line);
+            }
+            if (!line.empty()) {
+                memset(&line[0], 0, line.size());
+            }
+            jobs.assign(lines.size(), bcrypt_job());
+            hashes.assign(lines.size(), std::string());
+            for (size_t i = 0; i < lines.size(); i++) {
+                size_t sep = lines[i].find_first_of(" \t");
+                if (sep == std::string::npos) {
+                    sep = lines[i].size();
+                }
+                hashes[i] = lines[i].substr(0, sep);
+                size_t start = std::min(sep + 1, lines[i].size());
+                jobs[i].password = lines[i].data() + start;
+                jobs[i].password_len = lines[i].size() - start;
+                jobs[i].salt = hashes[i].c_str();
+            }
+            bcrypt_checkpw_batch(jobs.data(), jobs.size(), threads);
+            for (const bcrypt_job& job : jobs) {
+                puts(job.result == 1 ? "ok" : job.result == 0 ? "mismatch" : "invalid");
+                if (job.result != 1) {
+                    status = 1;
+                }
+            }
+            Wipe(lines);
+        }
+        return fflush(stdout) == 0 ? status : 1;
+    }
+
+    int HexDigit(char c) {
+        if (c >= '0' && c <= '9') {
+            return c - '0';
+        }
+        if (c >= 'a' && c <= 'f') {
+            return c - 'a' + 10;
+        }
+        if (c >= 'A' && c <= 'F') {
+            return c - 'A' + 10;
+        }
+        return -1;
+    }
+
+    // Reads the digests of one SHA-1 list, calling add for each. Blank
+    // lines are skipped; anything else that is not a digest is an error.
+    template <typename Add>
+    bool ReadDigests(const std::string& path, Add add) {
+        FILE* f = fopen(path.c_str(), "rb");
+        if (!f) {
+            fprintf(stderr, "bcrypt: could not open %s\n", path.c_str());
+            return false;
+        }
+        char line[256];
+        unsigned long long number = 0;
+        unsigned char sha1[BCRYPT_SHA1_SIZE];
+        bool ok = true;
+        while (ok && fgets(line, sizeof(line), f)) {
+            number++;
+            size_t len = strcspn(line, "\r\n");
+            if (len == 0) {
+                continue;
+            }
+            ok = len >= 2 * BCRYPT_SHA1_SIZE && (len == 2 * BCRYPT_SHA1_SIZE || line[2 * BCRYPT_SHA1_SIZE] == ':');
+            for (size_t i = 0; ok && i < BCRYPT_SHA1_SIZE; i++) {
+                int hi = HexDigit(line[2 * i]);
+                int lo = HexDigit(line[2 * i + 1]);
+                ok = hi >= 0 && lo >= 0;
+                sha1[i] = (unsigned char) (hi << 4 | lo);
+            }
+            if (ok) {
+                add(sha1);
+            } else {
+                fprintf(stderr, "bcrypt: %s:%llu: not a SHA-1 digest\n", path.c_str(), number);
+            }
+        }
+        fclose(f);
+        return ok;
+    }
+
+    // Writes a sibling temporary file and renames it over path, so processes
+    // that have the old file mapped keep reading it intact (truncating it in
+    // place would fault their mappings) and pick up the new one on reload.
+    bool ReplaceFile(const std::string& path, const unsigned char* data, size_t size) {
+        std::string tmp = path + ".tmp";
+        FILE* out = fopen(tmp.c_str(), "wb");
+        if (!out) {
+            fprintf(stderr, "bcrypt: could not create %s\n", tmp.c_str());
+            return false;
+        }
+        bool written = fwrite(data, 1, size, out) == size && fflush(out) == 0;
+#ifdef _WIN32
+        written = written && _commit(_fileno(out)) == 0;
+#else
+        written = written && fsync(fileno(out)) == 0;
+#endif
+        if (fclose(out) != 0 || !written) {
+            fprintf(stderr, "bcrypt: could not write %s\n", tmp.c_str());
+            remove(tmp.c_str());
+            return false;
+        }
+#ifdef _WIN32
+        bool renamed = MoveFileExA(tmp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+        bool renamed = rename(tmp.c_str(), path.c_str()) == 0;
+#endif
+        if (!renamed) {
+            fprintf(stderr, "bcrypt: could not replace %s\n", path.c_str());
+            remove(tmp.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    // Two passes over the inputs: one to size the filter, one to fill it.
+    int Filter(unsigned int bits, const std::string& output, const std::vector<std::string>& inputs) {
+        unsigned long long entries = 0;
+        for (const std::string& input : inputs) {
+            if (!ReadDigests(input, [&](const unsigned char*) { entries++; })) {
+                return 1;
+            }
+        }
+        size_t size = bcrypt_filter_size(entries, bits);
+        std::vector<unsigned char> data(size);
+        bcrypt_filter filter;
+        if (size == 0 || bcrypt_filter_create(&filter, entries, bits, data.data(), size) != BCRYPT_OK) {
+            fprintf(stderr, "bcrypt: too many digests\n");
+            return 1;
+        }
+        for (const std::string& input : inputs) {
+            if (!ReadDigests(input, [&](const unsigned char* sha1) { bcrypt_filter_add(&filter, sha1); })) {
+                return 1;
+            }
+        }
+        if (!ReplaceFile(output, data.data(), size)) {
+            return 1;
+        }
+        fprintf(stderr, "bcrypt: %llu digests, %zu bytes, %u bits set per digest\n",
+            entries, size, filter.hashes);
+        return 0;
+    }
+
+} // anonymous namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        Usage();
+    }
+    std::string command = argv[1];
+    int cost = 10;
+    char minor = 'b';
+    unsigned int threads = 0;
+
+    unsigned int bits = 16;
+    std::vector<std::string> files;
+
+    for (int i = 2; i < argc; i++) {
+        std::string arg = argv[i];
+        if (command == "filter" && (arg.empty() || arg[0] != '-')) {
+            files.push_back(arg);
+            continue;
+        }
+        if (i + 1 >= argc) {
+            Usage();
+        }
+        const char* value = argv[++i];
+        if (arg == "-c" && command == "hash") {
+            cost = atoi(value);
+            if (cost < 4 || cost > 31) {
+                fprintf(stderr, "bcrypt: cost must be between 4 and 31\n");
+                return 2;
+            }
+        } else if (arg == "-m" && command == "hash") {
+            if (strcmp(value, "a") != 0 && strcmp(value, "b") != 0) {
+                Usage();
+            }
+            minor = value[0];
+        } else if (arg == "-b" && command == "filter") {
+            bits = (unsigned int) atoi(value);
+            if (bits < 4 || bits > 64) {
+                fprintf(stderr, "bcrypt: bits must be between 4 and 64\n");
+                return 2;
+            }
+        } else if (arg == "-t" && command != "filter") {
+            threads = (unsigned int) atoi(value);
+        } else {
+            Usage();
+        }
+    }
+
+    if (command == "hash") {
+        return Hash(cost, minor, threads);
+    }
+    if (command == "verify") {
+        return Verify(threads);
+    }
+    if (command == "filter") {
+        if (files.size() < 2) {
+            Usage();
+        }
+        return Filter(bits, files[0], std::vector<std::string>(files.begin() + 1, files.end()));
+    }
+    Usage();
+    return 2;
+}
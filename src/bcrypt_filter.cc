@@ -0,0 +1,133 @@
+// Breached password filter, see include/bcrypt.h.
+//
+// A digest picks one block from its first 8 bytes and then sets or tests
+// `hashes` bits of that block, 9 bits of the digest per bit index, out of
+// the following 12 bytes. SHA-1 output is uniform, so no further hashing
+// is needed, and up to 10 indexes fit in the 96 bits available.
+
+#include <string.h>
+
+#include "bcrypt.h"
+
+namespace {
+
+    const char kMagic[8] = { 'B', 'C', 'R', 'Y', 'P', 'T', 'B', 'F' };
+    const unsigned int kVersion = 1;
+    const unsigned int kMaxHashes = 10;
+    const unsigned int kBlockBits = BCRYPT_FILTER_BLOCK_SIZE * 8;
+
+    void Store(unsigned char* p, unsigned long long v, int bytes) {
+        for (int i = 0; i < bytes; i++) {
+            p[i] = (unsigned char) (v >> (8 * i));
+        }
+    }
+
+    unsigned long long Load(const unsigned char* p, int bytes) {
+        unsigned long long v = 0;
+        for (int i = bytes - 1; i >= 0; i--) {
+            v = v << 8 | p[i];
+        }
+        return v;
+    }
+
+    // hashes ~ bits per entry * ln 2 minimizes false positives
+    unsigned int HashesFor(unsigned int bits_per_entry) {
+        unsigned int hashes = (bits_per_entry * 693 + 500) / 1000;
+        if (hashes < 1) {
+            return 1;
+        }
+        return hashes > kMaxHashes ? kMaxHashes : hashes;
+    }
+
+    unsigned long long BlocksFor(unsigned long long entries, unsigned int bits_per_entry) {
+        unsigned long long bits = entries * bits_per_entry;
+        unsigned long long blocks = (bits + kBlockBits - 1) / kBlockBits;
+        return blocks ? blocks : 1;
+    }
+
+    unsigned char* Block(const bcrypt_filter* filter, const unsigned char* sha1) {
+        unsigned long long index = 0;
+        for (int i = 0; i < 8; i++) {
+            index = index << 8 | sha1[i];
+        }
+        return filter->blocks + (index % filter->block_count) * BCRYPT_FILTER_BLOCK_SIZE;
+    }
+
+    // bit index i (0 to kMaxHashes - 1) within the block, from digest bits
+    // 64 + 9i onwards
+    unsigned int Bit(const unsigned char* sha1, unsigned int i) {
+        unsigned int offset = 64 + 9 * i;
+        unsigned int pair = (unsigned int) sha1[offset / 8] << 8 | sha1[offset / 8 + 1];
+        return (pair >> (7 - offset % 8)) & (kBlockBits - 1);
+    }
+
+} // anonymous namespace
+
+size_t bcrypt_filter_size(unsigned long long entries, unsigned int bits_per_entry) {
+    if (bits_per_entry < 4 || bits_per_entry > 64 || entries > (1ULL << 56)) {
+        return 0;
+    }
+    return BCRYPT_FILTER_HEADER_SIZE + BlocksFor(entries, bits_per_entry) * BCRYPT_FILTER_BLOCK_SIZE;
+}
+
+int bcrypt_filter_create(bcrypt_filter* filter, unsigned long long entries,
+    unsigned int bits_per_entry, void* data, size_t size) {
+    size_t needed = bcrypt_filter_size(entries, bits_per_entry);
+    if (!filter || !data || needed == 0 || size < needed) {
+        return BCRYPT_EINVAL;
+    }
+    unsigned char* header = (unsigned char*) data;
+    memset(header, 0, needed);
+    filter->blocks = header + BCRYPT_FILTER_HEADER_SIZE;
+    filter->block_count = BlocksFor(entries, bits_per_entry);
+    filter->entries = entries;
+    filter->hashes = HashesFor(bits_per_entry);
+    filter->bits_per_entry = bits_per_entry;
+    memcpy(header, kMagic, sizeof(kMagic));
+    Store(header + 8, kVersion, 4);
+    Store(header + 12, filter->hashes, 4);
+    Store(header + 16, filter->block_count, 8);
+    Store(header + 24, entries, 8);
+    Store(header + 32, bits_per_entry, 4);
+    return BCRYPT_OK;
+}
+
+int bcrypt_filter_open(bcrypt_filter* filter, const void* data, size_t size) {
+    const unsigned char* header = (const unsigned char*) data;
+    if (!filter || !data || size < BCRYPT_FILTER_HEADER_SIZE ||
+        memcmp(header, kMagic, sizeof(kMagic)) != 0 || Load(header + 8, 4) != kVersion) {
+        return BCRYPT_EINVAL;
+    }
+    unsigned long long hashes = Load(header + 12, 4);
+    unsigned long long blocks = Load(header + 16, 8);
+    if (hashes < 1 || hashes > kMaxHashes || blocks < 1 ||
+        blocks > (size - BCRYPT_FILTER_HEADER_SIZE) / BCRYPT_FILTER_BLOCK_SIZE) {
+        return BCRYPT_EINVAL;
+    }
+    // the blocks are only written through filters from bcrypt_filter_create
+    filter->blocks = (unsigned char*) header + BCRYPT_FILTER_HEADER_SIZE;
+    filter->block_count = blocks;
+    filter->entries = Load(header + 24, 8);
+    filter->hashes = (unsigned int) hashes;
+    filter->bits_per_entry = (unsigned int) Load(header + 32, 4);
+    return BCRYPT_OK;
+}
+
+void bcrypt_filter_add(bcrypt_filter* filter, const unsigned char* sha1) {
+    unsigned char* block = Block(filter, sha1);
+    for (unsigned int i = 0; i < filter->hashes; i++) {
+        unsigned int bit = Bit(sha1, i);
+        block[bit / 8] |= (unsigned char) (1 << (bit % 8));
+    }
+}
+
+int bcrypt_filter_test(const bcrypt_filter* filter, const unsigned char* sha1) {
+    const unsigned char* block = Block(filter, sha1);
+    for (unsigned int i = 0; i < filter->hashes; i++) {
+        unsigned int bit = Bit(sha1, i);
+        if (!(block[bit / 8] & (1 << (bit % 8)))) {
+            return 0;
+        }
+    }
+    return 1;
+}
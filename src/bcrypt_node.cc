@@ -1,13 +1,38 @@
-#define NAPI_VERSION 3
+#define NAPI_VERSION 4
 
 #include <napi.h>
+#include <uv.h>
 
 #include <string>
 #include <cstring>
+#include <cmath>
+#include <cstdio>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <new>
+#include <unordered_map>
 #include <vector>
+#include <thread>
+#include <algorithm>
+#include <chrono>
 #include <stdlib.h> // atoi
+#include <time.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #include "node_blf.h"
+#include "bcrypt.h"
 
 #define NODE_LESS_THAN (!(NODE_VERSION_AT_LEAST(0, 5, 4)))
 
@@ -65,27 +90,840 @@ namespace {
         return str[0];
     }
 
+    /* RESULTS */
+
+    // Salts and hashes are ASCII, so they can be created as one-byte strings
+    // straight from the bytes, skipping the UTF-8 decode of
+    // Napi::String::New.
+    inline Napi::String AsciiString(napi_env env, const char* str, size_t len) {
+        napi_value value;
+        napi_status status = napi_create_string_latin1(env, str, len, &value);
+        if (status != napi_ok) {
+            throw Napi::Error::New(env);
+        }
+        return Napi::String(env, value);
+    }
+
+    inline Napi::String AsciiString(napi_env env, const char* str) {
+        return AsciiString(env, str, strlen(str));
+    }
+
+    // Room a caller-supplied output Buffer must have at the offset: the
+    // longest hash bcrypt() produces.
+    const size_t BCRYPT_HASH_LEN = 60;
+
+    inline size_t OutputOffset(const Napi::Value& buffer, const Napi::Value& offset) {
+        Napi::Env env = buffer.Env();
+        if (!buffer.IsBuffer()) {
+            throw Napi::TypeError::New(env, "output must be a Buffer");
+        }
+        int64_t at = offset.As<Napi::Number>();
+        if (at < 0 || (uint64_t) at + BCRYPT_HASH_LEN > buffer.As<Napi::Buffer<char>>().Length()) {
+            throw Napi::RangeError::New(env, "output must have 60 bytes available at offset");
+        }
+        return (size_t) at;
+    }
+
+    /* INPUT BUFFERS */
+
+    // Key material as bcrypt() reads it. Only the first BLF_MAXUTILIZED (72)
+    // bytes ever reach the key schedule, but the full length still matters
+    // to $2a$ hashes, so it is kept alongside. Keys that fit are copied
+    // straight out of the JS value without a temporary std::string.
+    class KeyBuffer {
+        public:
+            KeyBuffer() : length(0) {
+                data[0] = '\0';
+            }
+
+            ~KeyBuffer() {
+                Wipe();
+            }
+
+            void Assign(const Napi::Value& value) {
+                if (value.IsBuffer()) {
+                    Napi::Buffer<char> buf = value.As<Napi::Buffer<char>>();
+                    Assign(buf.Data(), buf.Length());
+                    return;
+                }
+                napi_env env = value.Env();
+                size_t len;
+                napi_status status = napi_get_value_string_utf8(env, value, NULL, 0, &len);
+                if (status != napi_ok) {
+                    throw Napi::Error::New(env);
+                }
+                if (len < sizeof(data)) {
+                    napi_get_value_string_utf8(env, value, data, sizeof(data), &length);
+                } else {
+                    std::string str = value.As<Napi::String>();
+                    Assign(str.data(), str.length());
+                    memset(&str[0], 0, str.length());
+                }
+            }
+
+            void Assign(const char* src, size_t len) {
+                size_t n = len < BLF_MAXUTILIZED ? len : BLF_MAXUTILIZED;
+                memcpy(data, src, n);
+                data[n] = '\0';
+                length = len;
+            }
+
+            void Wipe() {
+                memset(data, 0, sizeof(data));
+                length = 0;
+            }
+
+            const char* Data() const { return data; }
+            size_t Length() const { return length; }
+
+        private:
+            char data[BLF_MAXUTILIZED + 1];
+            size_t length;
+    };
+
+    // Salts and hashes are short ASCII strings. Anything longer than
+    // _PASSWORD_LEN can neither be a valid salt prefix nor match a digest,
+    // so truncating there does not change any result.
+    class HashBuffer {
+        public:
+            HashBuffer() {
+                data[0] = '\0';
+            }
+
+            void Assign(const Napi::Value& value) {
+                napi_env env = value.Env();
+                size_t len;
+                napi_status status = napi_get_value_string_utf8(env, value, data, sizeof(data), &len);
+                if (status != napi_ok) {
+                    throw Napi::Error::New(env);
+                }
+            }
+
+            const char* Data() const { return data; }
+
+        private:
+            char data[_PASSWORD_LEN + 1];
+    };
+
+    /* WORKER POOL */
+
+    struct PoolStats {
+        uint64_t allocated;
+        uint64_t reused;
+        uint64_t cached;
+    };
+
+    thread_local PoolStats pool_stats = { 0, 0, 0 };
+
+    // Workers are created and destroyed on the JS thread that queued them
+    // (Napi::AsyncWorker deletes itself after OnOK/OnError), so every
+    // thread keeps a free list of worker-sized blocks per worker type and
+    // steady-state dispatch does not hit the allocator for the worker
+    // itself. That is the only allocation this removes: each call still
+    // gets a napi_async_work handle, a callback reference and an async
+    // resource object from N-API (a batched call a second async context),
+    // and a result value from V8 (hashInto avoids the result string).
+    template <typename T>
+    class Pooled {
+        public:
+            static void* operator new(size_t size) {
+                FreeList& list = Local();
+                if (size == sizeof(T) && list.head) {
+                    Block* block = list.head;
+                    list.head = block->next;
+                    list.count--;
+                    pool_stats.cached--;
+                    pool_stats.reused++;
+                    return block;
+                }
+                pool_stats.allocated++;
+                return ::operator new(size);
+            }
+
+            static void operator delete(void* ptr, size_t size) {
+                FreeList& list = Local();
+                if (size != sizeof(T) || list.count >= kMaxCached) {
+                    ::operator delete(ptr);
+                    return;
+                }
+                Block* block = static_cast<Block*>(ptr);
+                block->next = list.head;
+                list.head = block;
+                list.count++;
+                pool_stats.cached++;
+            }
+
+        private:
+            static const size_t kMaxCached = 256;
+
+            struct Block {
+                Block* next;
+            };
+
+            struct FreeList {
+                Block* head;
+                size_t count;
+
+                FreeList() : head(NULL), count(0) {}
+
+                ~FreeList() {
+                    while (head) {
+                        Block* next = head->next;
+                        ::operator delete(head);
+                        head = next;
+                    }
+                }
+            };
+
+            static FreeList& Local() {
+                static thread_local FreeList list;
+                return list;
+            }
+    };
+
+    /* CPU ACCOUNTING AND TENANTS */
+
+    // CPU time consumed by the calling thread, in nanoseconds.
+    uint64_t ThreadCpuTime() {
+#if defined(_WIN32)
+        FILETIME creation, exit, kernel, user;
+        if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) {
+            return 0;
+        }
+        uint64_t ticks = ((uint64_t) kernel.dwHighDateTime << 32 | kernel.dwLowDateTime) +
+            ((uint64_t) user.dwHighDateTime << 32 | user.dwLowDateTime);
+        return ticks * 100;
+#elif defined(CLOCK_THREAD_CPUTIME_ID)
+        struct timespec ts;
+        if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+            return 0;
+        }
+        return (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+#else
+        return 0;
+#endif
+    }
+
+    class AccountedWorker;
+
+    // Scheduling state of a tenant.
+    struct Tenant {
+        uint32_t maxInFlight;   // 0 for no limit
+        uint32_t inFlight;
+        std::deque<AccountedWorker*> pending;
+        const std::string* key; // the map's own copy
+
+        Tenant() : maxInFlight(0), inFlight(0), key(NULL) {}
+    };
+
+    // What a tenant's completed jobs used. Kept apart from the scheduling
+    // state, which is dropped between bursts, so totals build up until they
+    // are collected with take_tenant_usage.
+    struct TenantUsage {
+        uint64_t completed;
+        uint64_t cpuTime;       // nanoseconds
+
+        TenantUsage() : completed(0), cpuTime(0) {}
+    };
+
+    // Like the worker pool, tenants belong to the JS thread that dispatches
+    // their jobs, so they need no locking. An entry lives while it has jobs
+    // in flight or queued, or a limit of its own; map nodes do not move, so
+    // the Tenant pointers held by in-flight workers stay valid until then.
+    thread_local std::unordered_map<std::string, Tenant> tenants;
+
+    // One entry per key with uncollected usage.
+    thread_local std::unordered_map<std::string, TenantUsage> tenant_usage;
+
+    Tenant* FindTenant(const std::string& key) {
+        std::unordered_map<std::string, Tenant>::iterator it = tenants.emplace(key, Tenant()).first;
+        it->second.key = &it->first;
+        return &it->second;
+    }
+
+    // Erases an idle tenant without a limit, so one-off keys do not pile up.
+    // Its usage stays in tenant_usage.
+    void ForgetIfIdle(Tenant* tenant) {
+        if (!tenant->maxInFlight && !tenant->inFlight && tenant->pending.empty()) {
+            tenants.erase(tenants.find(*tenant->key));
+        }
+    }
+
+    // Opt-in batched delivery. A batched worker skips N-API's async work,
+    // whose completion opens a handle scope and a callback scope and runs
+    // hooks on the JS thread for every job: it goes to the libuv pool
+    // directly, where the completion only releases it. Execute() pushes it
+    // onto a lock-free stack, and the first push after a drain wakes the JS
+    // thread through a thread-safe function that delivers everything queued
+    // so far in one go, so microtasks and ticks run once per batch instead
+    // of once per result.
+    struct CompletionQueue {
+        bool enabled;
+        bool started;
+        bool asyncContext;      // call back in each submitter's async context
+        uv_loop_t* loop;
+        Napi::ThreadSafeFunction tsfn;
+        std::atomic<AccountedWorker*> head;
+        size_t outstanding;     // dispatched, not yet delivered; JS thread only
+        uint64_t batches;
+        uint64_t delivered;
+
+        CompletionQueue()
+            : enabled(false), started(false), asyncContext(true), loop(NULL), head(NULL),
+              outstanding(0), batches(0), delivered(0) {}
+    };
+
+    thread_local CompletionQueue completions;
+
+    void DrainCompletions(Napi::Env env, CompletionQueue* queue);
+
+    // Raises a callback's exception as uncaught, each on its own. A throw
+    // out of a thread-safe function call only gets a warning from Node, and
+    // rethrowing the first of several would hide the rest, where uv
+    // completions would have raised every one of them.
+    inline void RaiseUncaught(Napi::Env env, const Napi::Error& error) {
+        napi_fatal_exception(env, error.Value());
+    }
+
+    // Base of the hashing workers. Execute() is timed on the thread CPU
+    // clock, and jobs dispatched under a tenant key wait in the tenant's
+    // queue, off the thread pool, while the tenant is at its in-flight limit.
+    class AccountedWorker : public Napi::AsyncWorker {
+        public:
+            void Execute() {
+                uint64_t start = ThreadCpuTime();
+                try {
+                    Run();
+                } catch (const std::exception& e) {
+                    // a batched worker must still reach its drain
+                    SetError(e.what());
+                }
+                cpuTime = ThreadCpuTime() - start;
+                if (batch) {
+                    // the drain may run before this returns, so this must be
+                    // the last use of the worker on the pool thread
+                    Push(batch, this);
+                }
+            }
+
+            void OnWorkComplete(Napi::Env env, napi_status status) {
+                Settle();
+                Napi::AsyncWorker::OnWorkComplete(env, status);
+            }
+
+            void Dispatch(const Napi::Value& tenantKey) {
+                if (completions.enabled) {
+                    batch = &completions;
+                    holds = 2;
+                    if (batch->asyncContext) {
+                        context.reset(new Napi::AsyncContext(Env(), resourceName));
+                    }
+                    if (batch->outstanding++ == 0) {
+                        batch->tsfn.Ref(Env());
+                    }
+                }
+                if (tenantKey.IsString()) {
+                    tenant = FindTenant(tenantKey.As<Napi::String>());
+                    if (tenant->maxInFlight && tenant->inFlight >= tenant->maxInFlight) {
+                        tenant->pending.push_back(this);
+                        return;
+                    }
+                    tenant->inFlight++;
+                }
+                Start();
+            }
+
+            // Queues parked jobs while the tenant is under its limit.
+            static void Drain(Tenant* tenant) {
+                while (!tenant->pending.empty() &&
+                        (!tenant->maxInFlight || tenant->inFlight < tenant->maxInFlight)) {
+                    AccountedWorker* next = tenant->pending.front();
+                    tenant->pending.pop_front();
+                    tenant->inFlight++;
+                    next->Start();
+                }
+            }
+
+            // Calls back a batched worker from a drain. The drain runs in the
+            // thread-safe function's async context, so the callback is run
+            // under the context captured at dispatch, as the worker's own uv
+            // completion would, for AsyncLocalStorage and async_hooks, unless
+            // the application turned that off.
+            void Deliver() {
+                if (context) {
+                    Napi::CallbackScope scope(Env(), *context);
+                    Complete();
+                } else {
+                    Complete();
+                }
+            }
+
+            // A batched worker is deleted once both its uv completion and
+            // its delivery have run, in whichever order they come.
+            void Release() {
+                if (--holds == 0) {
+                    delete this;
+                }
+            }
+
+            AccountedWorker* next;
+
+        protected:
+            AccountedWorker(const Napi::Function& callback, const char* resource_name)
+                : Napi::AsyncWorker(callback, resource_name), next(NULL), resourceName(resource_name),
+                  tenant(NULL), batch(NULL), holds(0), cpuTime(0) {
+            }
+
+            virtual void Run() = 0;
+
+            // Hides Napi::AsyncWorker::SetError so batched deliveries can
+            // report the error as well.
+            void SetError(const std::string& error) {
+                failure = error;
+                Napi::AsyncWorker::SetError(error);
+            }
+
+            // Reported to callbacks in microseconds, like process.cpuUsage().
+            Napi::Value CpuTime() {
+                return Napi::Number::New(Env(), cpuTime / 1000.0);
+            }
+
+        private:
+            // The pool's completion of a batched worker is a plain C call:
+            // the result is delivered by the drain.
+            void Start() {
+                if (!batch) {
+                    Queue();
+                    return;
+                }
+                work.data = this;
+                uv_queue_work(batch->loop, &work, [](uv_work_t* req) {
+                    static_cast<AccountedWorker*>(req->data)->Execute();
+                }, [](uv_work_t* req, int status) {
+                    static_cast<AccountedWorker*>(req->data)->Release();
+                });
+            }
+
+            void Complete() {
+                Settle();
+                try {
+                    if (failure.empty()) {
+                        OnOK();
+                    } else {
+                        Callback().Call({Napi::Error::New(Env(), failure).Value()});
+                    }
+                } catch (Napi::Error& e) {
+                    RaiseUncaught(Env(), e);
+                }
+            }
+
+            static void Push(CompletionQueue* queue, AccountedWorker* worker) {
+                AccountedWorker* head = queue->head.load(std::memory_order_relaxed);
+                do {
+                    worker->next = head;
+                } while (!queue->head.compare_exchange_weak(head, worker,
+                            std::memory_order_release, std::memory_order_relaxed));
+                if (head == NULL) {
+                    queue->tsfn.NonBlockingCall([queue](Napi::Env env, Napi::Function) {
+                        DrainCompletions(env, queue);
+                    });
+                }
+            }
+
+            void Settle() {
+                if (tenant) {
+                    tenant->inFlight--;
+                    TenantUsage& usage = tenant_usage[*tenant->key];
+                    usage.completed++;
+                    usage.cpuTime += cpuTime;
+                    Drain(tenant);
+                    ForgetIfIdle(tenant);
+                    tenant = NULL;
+                }
+            }
+
+            const char* resourceName;
+            Tenant* tenant;
+            CompletionQueue* batch;
+            std::unique_ptr<Napi::AsyncContext> context;    // batched only
+            uv_work_t work;                                 // batched only
+            int holds;
+            uint64_t cpuTime;
+            std::string failure;
+    };
+
+    void DrainCompletions(Napi::Env env, CompletionQueue* queue) {
+        // the stack is newest first
+        AccountedWorker* list = queue->head.exchange(NULL, std::memory_order_acquire);
+        AccountedWorker* ordered = NULL;
+        while (list) {
+            AccountedWorker* next = list->next;
+            list->next = ordered;
+            ordered = list;
+            list = next;
+        }
+        if (!ordered) {
+            return;
+        }
+        queue->batches++;
+
+        // a callback that throws is raised as uncaught by Deliver(), so
+        // every worker is delivered and released
+        Napi::HandleScope scope(env);
+        while (ordered) {
+            AccountedWorker* worker = ordered;
+            ordered = worker->next;
+            worker->Deliver();
+            worker->Release();
+            queue->delivered++;
+            if (--queue->outstanding == 0) {
+                queue->tsfn.Unref(env);
+            }
+        }
+    }
+
+    Napi::Value NoOp(const Napi::CallbackInfo& info) {
+        return info.Env().Undefined();
+    }
+
+    // set_batch_completions(enabled, asyncContext)
+    Napi::Value SetBatchCompletions(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        if (info.Length() < 1) {
+            throw Napi::TypeError::New(env, "1 argument expected");
+        }
+        bool enabled = info[0].ToBoolean();
+        if (enabled && !completions.started) {
+            if (napi_get_uv_event_loop(env, &completions.loop) != napi_ok) {
+                throw Napi::Error::New(env, "could not get the event loop");
+            }
+            // the thread-safe function only keeps the loop alive while
+            // batched jobs are outstanding
+            completions.tsfn = Napi::ThreadSafeFunction::New(env,
+                Napi::Function::New(env, NoOp), "bcrypt:completions", 0, 1);
+            completions.tsfn.Unref(env);
+            completions.started = true;
+        }
+        // jobs already dispatched keep the mode they were dispatched with
+        completions.enabled = enabled;
+        completions.asyncContext = info.Length() < 2 || info[1].ToBoolean();
+        return env.Undefined();
+    }
+
+    Napi::Value CompletionStats(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        Napi::Object stats = Napi::Object::New(env);
+        stats.Set("enabled", Napi::Boolean::New(env, completions.enabled));
+        stats.Set("batches", Napi::Number::New(env, (double) completions.batches));
+        stats.Set("delivered", Napi::Number::New(env, (double) completions.delivered));
+        stats.Set("outstanding", Napi::Number::New(env, (double) completions.outstanding));
+        return stats;
+    }
+
+    inline Napi::Value TenantArg(const Napi::CallbackInfo& info, size_t index) {
+        return info.Length() > index ? info[index] : info.Env().Undefined();
+    }
+
+    Napi::Object UsageToObject(Napi::Env env, const TenantUsage& usage) {
+        Napi::Object obj = Napi::Object::New(env);
+        obj.Set("completed", Napi::Number::New(env, (double) usage.completed));
+        obj.Set("cpuTime", Napi::Number::New(env, usage.cpuTime / 1000.0));
+        return obj;
+    }
+
+    Napi::Value SetTenantLimit(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        if (info.Length() < 2) {
+            throw Napi::TypeError::New(env, "2 arguments expected");
+        }
+        Tenant* tenant = FindTenant(info[0].As<Napi::String>());
+        tenant->maxInFlight = info[1].As<Napi::Number>();
+        AccountedWorker::Drain(tenant);
+        ForgetIfIdle(tenant);
+        return env.Undefined();
+    }
+
+    Napi::Value TenantStats(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        if (info.Length() < 1) {
+            throw Napi::TypeError::New(env, "1 argument expected");
+        }
+        std::string key = info[0].As<Napi::String>();
+        Tenant idle;
+        std::unordered_map<std::string, Tenant>::const_iterator it = tenants.find(key);
+        const Tenant& tenant = it == tenants.end() ? idle : it->second;
+        TenantUsage none;
+        std::unordered_map<std::string, TenantUsage>::const_iterator used = tenant_usage.find(key);
+        const TenantUsage& usage = used == tenant_usage.end() ? none : used->second;
+        Napi::Object stats = Napi::Object::New(env);
+        stats.Set("maxInFlight", Napi::Number::New(env, tenant.maxInFlight));
+        stats.Set("inFlight", Napi::Number::New(env, tenant.inFlight));
+        stats.Set("pending", Napi::Number::New(env, (double) tenant.pending.size()));
+        stats.Set("completed", Napi::Number::New(env, (double) usage.completed));
+        stats.Set("cpuTime", Napi::Number::New(env, usage.cpuTime / 1000.0));
+        return stats;
+    }
+
+    // take_tenant_usage(key) returns one tenant's usage and starts it over;
+    // take_tenant_usage() returns every tenant's, keyed by tenant, and
+    // empties the ledger
+    Napi::Value TakeTenantUsage(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        if (info.Length() > 0 && info[0].IsString()) {
+            std::string key = info[0].As<Napi::String>();
+            TenantUsage taken;
+            std::unordered_map<std::string, TenantUsage>::iterator it = tenant_usage.find(key);
+            if (it != tenant_usage.end()) {
+                taken = it->second;
+                tenant_usage.erase(it);
+            }
+            return UsageToObject(env, taken);
+        }
+        Napi::Object all = Napi::Object::New(env);
+        for (const auto& entry : tenant_usage) {
+            all.Set(entry.first, UsageToObject(env, entry.second));
+        }
+        tenant_usage.clear();
+        return all;
+    }
+
+    /* SYNC CALL WATCHDOG */
+
+    enum SyncPolicy { SYNC_WARN, SYNC_THROW, SYNC_REJECT };
+
+    // histogram bucket i counts calls shorter than 2^i ms, the last one the rest
+    const int SYNC_BUCKETS = 12;
+
+    struct SyncSite {
+        uint64_t calls;
+        uint64_t slow;
+        uint64_t rejected;
+        uint64_t totalTime;     // microseconds
+        uint64_t maxTime;
+        uint64_t histogram[SYNC_BUCKETS];
+        std::string stack;      // of the slowest call over the threshold, if captured
+
+        SyncSite() : calls(0), slow(0), rejected(0), totalTime(0), maxTime(0), histogram() {}
+    };
+
+    // Opt-in timing of the sync calls, which run bcrypt on the JS thread.
+    // While it is enabled the JS layer passes the caller's location, and its
+    // stack if asked to capture one, as two trailing arguments; calls
+    // without a location are not watched.
+    struct SyncWatchdog {
+        bool enabled;
+        SyncPolicy policy;
+        uint64_t threshold;     // microseconds
+        Napi::FunctionReference onSlow;
+        std::unordered_map<std::string, SyncSite> sites;
+        double costTime[32];    // recent microseconds per cost, 0 if unseen
+
+        SyncWatchdog() : enabled(false), policy(SYNC_WARN), threshold(0), costTime() {
+            // may outlive the env at thread exit; Reset() releases it instead
+            onSlow.SuppressDestruct();
+        }
+
+        // Predicted duration of a call at cost, scaling the nearest cost
+        // seen so far by 2 per step, or 0 if nothing has been timed yet.
+        double Expected(int cost) const {
+            for (int d = 0; d < 32; d++) {
+                if (cost - d >= 0 && costTime[cost - d] > 0) {
+                    return ldexp(costTime[cost - d], d);
+                }
+                if (cost + d < 32 && costTime[cost + d] > 0) {
+                    return ldexp(costTime[cost + d], -d);
+                }
+            }
+            return 0;
+        }
+    };
+
+    thread_local SyncWatchdog sync_watchdog;
+
+    // Thread CPU time of the last sync call that completed, in nanoseconds,
+    // for JS callers that time inline work on the same clock as the pool.
+    thread_local uint64_t last_sync_cpu_time = 0;
+
+    // The cost of a salt or hash string, or 0 if it has none.
+    inline int HashCost(const char* hash) {
+        if (hash[0] != '$' || hash[1] != '2') {
+            return 0;
+        }
+        const char* p = hash[2] == '$' ? hash + 3 : hash + 4;
+        if (p[0] < '0' || p[0] > '9' || p[1] < '0' || p[1] > '9') {
+            return 0;
+        }
+        int cost = (p[0] - '0') * 10 + (p[1] - '0');
+        return cost < 32 ? cost : 0;
+    }
+
+    // Watches one sync call: constructed before bcrypt runs, which it may
+    // refuse under the reject policy, and Done() once it has.
+    class SyncCall {
+        public:
+            SyncCall(const Napi::CallbackInfo& info, size_t siteArg, const char* op, int cost)
+                : env(info.Env()), op(op), cost(cost), site(NULL), cpuStart(ThreadCpuTime()) {
+                SyncWatchdog& watchdog = sync_watchdog;
+                if (!watchdog.enabled || info.Length() <= siteArg || !info[siteArg].IsString()) {
+                    return;
+                }
+                name = info[siteArg].As<Napi::String>().Utf8Value();
+                if (info.Length() > siteArg + 1 && info[siteArg + 1].IsString()) {
+                    stack = info[siteArg + 1].As<Napi::String>().Utf8Value();
+                }
+                site = &watchdog.sites[name];
+                if (watchdog.policy == SYNC_REJECT && cost > 0) {
+                    double expected = watchdog.Expected(cost);
+                    if (expected > watchdog.threshold) {
+                        site->rejected++;
+                        char message[160];
+                        snprintf(message, sizeof(message),
+                            "%s at cost %d would block the event loop for about %.1f ms (threshold %.1f ms) at ",
+                            op, cost, expected / 1000.0, watchdog.threshold / 1000.0);
+                        throw Napi::Error::New(env, message + name);
+                    }
+                }
+                start = std::chrono::steady_clock::now();
+            }
+
+            void Done() {
+                last_sync_cpu_time = ThreadCpuTime() - cpuStart;
+                if (site == NULL) {
+                    return;
+                }
+                SyncWatchdog& watchdog = sync_watchdog;
+                uint64_t elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - start).count();
+                int bucket = 0;
+                for (uint64_t ms = elapsed / 1000; ms > 0 && bucket < SYNC_BUCKETS - 1; ms >>= 1) {
+                    bucket++;
+                }
+                site->calls++;
+                site->totalTime += elapsed;
+                site->histogram[bucket]++;
+                if (cost > 0) {
+                    double& recent = watchdog.costTime[cost];
+                    recent = recent > 0 ? 0.75 * recent + 0.25 * elapsed : elapsed;
+                }
+                bool slowest = elapsed >= site->maxTime;
+                site->maxTime = std::max(site->maxTime, elapsed);
+                if (elapsed <= watchdog.threshold) {
+                    return;
+                }
+                site->slow++;
+                if (slowest && !stack.empty()) {
+                    site->stack = stack;
+                }
+                char message[160];
+                snprintf(message, sizeof(message),
+                    "%s at cost %d blocked the event loop for %.1f ms (threshold %.1f ms) at ",
+                    op, cost, elapsed / 1000.0, watchdog.threshold / 1000.0);
+                if (watchdog.policy == SYNC_THROW) {
+                    throw Napi::Error::New(env, message + name);
+                }
+                if (!watchdog.onSlow.IsEmpty()) {
+                    watchdog.onSlow.Call({
+                        Napi::String::New(env, message + name),
+                        stack.empty() ? env.Undefined() : Napi::String::New(env, stack)
+                    });
+                }
+            }
+
+        private:
+            Napi::Env env;
+            const char* op;
+            int cost;
+            SyncSite* site;
+            std::string name;
+            std::string stack;
+            uint64_t cpuStart;
+            std::chrono::steady_clock::time_point start;
+    };
+
+    // set_sync_watchdog(enabled, threshold, policy, onSlow): threshold in
+    // microseconds; enabling starts the per-site stats over
+    Napi::Value SetSyncWatchdog(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        if (info.Length() < 1) {
+            throw Napi::TypeError::New(env, "1 argument expected");
+        }
+        SyncWatchdog& watchdog = sync_watchdog;
+        watchdog.enabled = info[0].ToBoolean();
+        watchdog.onSlow.Reset();
+        if (!watchdog.enabled) {
+            return env.Undefined();
+        }
+        if (info.Length() < 4) {
+            throw Napi::TypeError::New(env, "4 arguments expected");
+        }
+        watchdog.threshold = (uint64_t) info[1].As<Napi::Number>().Int64Value();
+        watchdog.policy = (SyncPolicy) info[2].As<Napi::Number>().Int32Value();
+        if (info[3].IsFunction()) {
+            watchdog.onSlow.Reset(info[3].As<Napi::Function>(), 1);
+        }
+        watchdog.sites.clear();
+        return env.Undefined();
+    }
+
+    Napi::Value SyncWatchdogStats(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        Napi::Object stats = Napi::Object::New(env);
+        Napi::Object sites = Napi::Object::New(env);
+        for (const auto& entry : sync_watchdog.sites) {
+            const SyncSite& site = entry.second;
+            Napi::Object item = Napi::Object::New(env);
+            Napi::Array histogram = Napi::Array::New(env, SYNC_BUCKETS);
+            for (int i = 0; i < SYNC_BUCKETS; i++) {
+                histogram.Set((uint32_t) i, Napi::Number::New(env, (double) site.histogram[i]));
+            }
+            item.Set("calls", Napi::Number::New(env, (double) site.calls));
+            item.Set("slow", Napi::Number::New(env, (double) site.slow));
+            item.Set("rejected", Napi::Number::New(env, (double) site.rejected));
+            item.Set("totalTime", Napi::Number::New(env, (double) site.totalTime));
+            item.Set("maxTime", Napi::Number::New(env, (double) site.maxTime));
+            item.Set("histogram", histogram);
+            if (!site.stack.empty()) {
+                item.Set("stack", Napi::String::New(env, site.stack));
+            }
+            sites.Set(entry.first, item);
+        }
+        stats.Set("enabled", Napi::Boolean::New(env, sync_watchdog.enabled));
+        stats.Set("sites", sites);
+        return stats;
+    }
+
+    // In microseconds, like the CPU time passed to async callbacks. Reading
+    // clears it, so a sync call that bailed out before hashing reads 0.
+    Napi::Value SyncCpuTime(const Napi::CallbackInfo& info) {
+        double time = last_sync_cpu_time / 1000.0;
+        last_sync_cpu_time = 0;
+        return Napi::Number::New(info.Env(), time);
+    }
+
     /* SALT GENERATION */
 
-    class SaltAsyncWorker : public Napi::AsyncWorker {
+    class SaltAsyncWorker : public Napi::AsyncWorker, public Pooled<SaltAsyncWorker> {
         public:
-            SaltAsyncWorker(const Napi::Function& callback, const std::string& seed, ssize_t rounds, char minor_ver)
-                : Napi::AsyncWorker(callback, "bcrypt:SaltAsyncWorker"), seed(seed), rounds(rounds), minor_ver(minor_ver) {
+            SaltAsyncWorker(const Napi::Function& callback, const char* seed, ssize_t rounds, char minor_ver)
+                : Napi::AsyncWorker(callback, "bcrypt:SaltAsyncWorker"), rounds(rounds), minor_ver(minor_ver) {
+                memcpy(this->seed, seed, sizeof(this->seed));
             }
 
-            ~SaltAsyncWorker() {}
+            ~SaltAsyncWorker() {
+                memset(seed, 0, sizeof(seed));
+            }
 
             void Execute() {
-                bcrypt_gensalt(minor_ver, rounds, (u_int8_t *)&seed[0], salt);
+                bcrypt_gensalt(minor_ver, rounds, seed, salt);
             }
 
             void OnOK() {
                 Napi::HandleScope scope(Env());
-                Callback().Call({Env().Undefined(), Napi::String::New(Env(), salt)});
+                Callback().Call({Env().Undefined(), AsciiString(Env(), salt)});
             }
 
         private:
-            std::string seed;
+            u_int8_t seed[BCRYPT_MAXSALT];
             ssize_t rounds;
             char minor_ver;
             char salt[_SALT_LEN];
@@ -107,7 +945,7 @@ namespace {
         const int32_t rounds = info[1].As<Napi::Number>();
         Napi::Buffer<char> seed = info[2].As<Napi::Buffer<char>>();
         Napi::Function callback = info[3].As<Napi::Function>();
-        SaltAsyncWorker* saltWorker = new SaltAsyncWorker(callback, std::string(seed.Data(), 16), rounds, minor_ver);
+        SaltAsyncWorker* saltWorker = new SaltAsyncWorker(callback, seed.Data(), rounds, minor_ver);
         saltWorker->Queue();
         return env.Undefined();
     }
@@ -129,69 +967,117 @@ namespace {
         u_int8_t* seed = (u_int8_t*) buffer.Data();
         char salt[_SALT_LEN];
         bcrypt_gensalt(minor_ver, rounds, seed, salt);
-        return Napi::String::New(env, salt, strlen(salt));
-    }
-
-    inline std::string BufferToString(const Napi::Buffer<char> &buf) {
-        return std::string(buf.Data(), buf.Length());
+        return AsciiString(env, salt);
     }
 
     /* ENCRYPT DATA - USED TO BE HASHPW */
 
-    class EncryptAsyncWorker : public Napi::AsyncWorker {
+    class EncryptAsyncWorker : public AccountedWorker, public Pooled<EncryptAsyncWorker> {
         public:
-            EncryptAsyncWorker(const Napi::Function& callback, const std::string& input, const std::string& salt)
-                : Napi::AsyncWorker(callback, "bcrypt:EncryptAsyncWorker"), input(input), salt(salt) {
+            EncryptAsyncWorker(const Napi::Function& callback, const Napi::Value& input, const Napi::Value& salt)
+                : AccountedWorker(callback, "bcrypt:EncryptAsyncWorker"), offset(0) {
+                this->input.Assign(input);
+                this->salt.Assign(salt);
             }
 
             ~EncryptAsyncWorker() {}
 
-            void Execute() {
-                if (!(ValidateSalt(salt.c_str()))) {
+            // Writes the hash into buffer at offset instead of creating a
+            // string, and calls back with its length.
+            void SetOutput(const Napi::Buffer<char>& buffer, size_t offset) {
+                output = Napi::Persistent(buffer);
+                this->offset = offset;
+            }
+
+            void Run() {
+                if (!(ValidateSalt(salt.Data()))) {
                     SetError("Invalid salt. Salt must be in the form of: $Vers$log2(NumRounds)$saltvalue");
                 }
-                bcrypt(input.c_str(), input.length(), salt.c_str(), bcrypted);
+                bcrypt(input.Data(), input.Length(), salt.Data(), bcrypted);
             }
 
             void OnOK() {
                 Napi::HandleScope scope(Env());
-                Callback().Call({Env().Undefined(),Napi::String::New(Env(), bcrypted)});
+                if (output.IsEmpty()) {
+                    Callback().Call({Env().Undefined(), AsciiString(Env(), bcrypted), CpuTime()});
+                    return;
+                }
+                size_t len = strlen(bcrypted);
+                memcpy(output.Value().Data() + offset, bcrypted, len);
+                output.Reset();
+                Callback().Call({Env().Undefined(), Napi::Number::New(Env(), (double) len), CpuTime()});
             }
         private:
-            std::string input;
-            std::string salt;
+            KeyBuffer input;
+            HashBuffer salt;
             char bcrypted[_PASSWORD_LEN];
+            Napi::Reference<Napi::Buffer<char>> output;
+            size_t offset;
     };
 
     Napi::Value Encrypt(const Napi::CallbackInfo& info) {
         if (info.Length() < 3) {
             throw Napi::TypeError::New(info.Env(), "3 arguments expected");
         }
-        std::string data = info[0].IsBuffer()
-            ? BufferToString(info[0].As<Napi::Buffer<char>>())
-            : info[0].As<Napi::String>();
-        std::string salt = info[1].As<Napi::String>();
         Napi::Function callback = info[2].As<Napi::Function>();
-        EncryptAsyncWorker* encryptWorker = new EncryptAsyncWorker(callback, data, salt);
-        encryptWorker->Queue();
+        EncryptAsyncWorker* encryptWorker = new EncryptAsyncWorker(callback, info[0], info[1]);
+        encryptWorker->Dispatch(TenantArg(info, 3));
+        return info.Env().Undefined();
+    }
+
+    // encrypt_into(data, salt, output, offset, cb, tenant)
+    Napi::Value EncryptInto(const Napi::CallbackInfo& info) {
+        if (info.Length() < 5) {
+            throw Napi::TypeError::New(info.Env(), "5 arguments expected");
+        }
+        size_t offset = OutputOffset(info[2], info[3]);
+        Napi::Function callback = info[4].As<Napi::Function>();
+        EncryptAsyncWorker* encryptWorker = new EncryptAsyncWorker(callback, info[0], info[1]);
+        encryptWorker->SetOutput(info[2].As<Napi::Buffer<char>>(), offset);
+        encryptWorker->Dispatch(TenantArg(info, 5));
         return info.Env().Undefined();
     }
 
+    // encrypt_into_sync(data, salt, output, offset[, site, stack])
+    Napi::Value EncryptIntoSync(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        if (info.Length() < 4) {
+            throw Napi::TypeError::New(env, "4 arguments expected");
+        }
+        size_t offset = OutputOffset(info[2], info[3]);
+        KeyBuffer data;
+        data.Assign(info[0]);
+        HashBuffer salt;
+        salt.Assign(info[1]);
+        if (!(ValidateSalt(salt.Data()))) {
+            throw Napi::Error::New(env, "Invalid salt. Salt must be in the form of: $Vers$log2(NumRounds)$saltvalue");
+        }
+        SyncCall call(info, 4, "hashIntoSync", HashCost(salt.Data()));
+        char bcrypted[_PASSWORD_LEN];
+        bcrypt(data.Data(), data.Length(), salt.Data(), bcrypted);
+        call.Done();
+        size_t len = strlen(bcrypted);
+        memcpy(info[2].As<Napi::Buffer<char>>().Data() + offset, bcrypted, len);
+        return Napi::Number::New(env, (double) len);
+    }
+
     Napi::Value EncryptSync(const Napi::CallbackInfo& info) {
         Napi::Env env = info.Env();
         if (info.Length() < 2) {
             throw Napi::TypeError::New(info.Env(), "2 arguments expected");
         }
-        std::string data = info[0].IsBuffer()
-            ? BufferToString(info[0].As<Napi::Buffer<char>>())
-            : info[0].As<Napi::String>();
-        std::string salt = info[1].As<Napi::String>();
-        if (!(ValidateSalt(salt.c_str()))) {
+        KeyBuffer data;
+        data.Assign(info[0]);
+        HashBuffer salt;
+        salt.Assign(info[1]);
+        if (!(ValidateSalt(salt.Data()))) {
             throw Napi::Error::New(env, "Invalid salt. Salt must be in the form of: $Vers$log2(NumRounds)$saltvalue");
         }
+        SyncCall call(info, 2, "hashSync", HashCost(salt.Data()));
         char bcrypted[_PASSWORD_LEN];
-        bcrypt(data.c_str(), data.length(), salt.c_str(), bcrypted);
-        return Napi::String::New(env, bcrypted, strlen(bcrypted));
+        bcrypt(data.Data(), data.Length(), salt.Data(), bcrypted);
+        call.Done();
+        return AsciiString(env, bcrypted);
     }
 
     /* COMPARATOR */
@@ -199,66 +1085,470 @@ namespace {
         return strcmp(s1, s2) == 0;
     }
 
-    class CompareAsyncWorker : public Napi::AsyncWorker {
+    class CompareAsyncWorker;
+
+    // Opt-in single-flight for compares. While a compare runs, identical
+    // requests attach to it as followers and get its result instead of
+    // computing it again. Flights are keyed by a SHA-512 of a random key,
+    // the password, the hash and the tenant key, so the table never holds
+    // the password and a compare never waits behind another tenant's queue.
+    // Like tenants, flights belong to the JS thread that dispatches them.
+    struct CompareFlights {
+        bool enabled;
+        u_int8_t key[32];
+        uint64_t flights;
+        uint64_t joined;
+        std::unordered_map<std::string, CompareAsyncWorker*> leaders;
+
+        CompareFlights() : enabled(false), flights(0), joined(0) {
+            memset(key, 0, sizeof(key));
+        }
+    };
+
+    thread_local CompareFlights compare_flights;
+
+    std::string FlightKey(const KeyBuffer& input, const HashBuffer& encrypted, const Napi::Value& tenantKey) {
+        u_int8_t length[8];
+        for (size_t i = 0; i < sizeof(length); i++) {
+            length[i] = (u_int8_t) ((uint64_t) input.Length() >> (8 * i));
+        }
+        // the hash is NUL terminated, so the tenant can simply come last,
+        // after a byte telling "no tenant" apart from an empty key
+        std::string tenant = tenantKey.IsString() ? "\x01" + tenantKey.As<Napi::String>().Utf8Value() : std::string(1, '\0');
+        const u_int8_t* parts[5] = {
+            compare_flights.key,
+            length,
+            (const u_int8_t*) input.Data(),
+            (const u_int8_t*) encrypted.Data(),
+            (const u_int8_t*) tenant.data(),
+        };
+        size_t lens[5] = {
+            sizeof(compare_flights.key),
+            sizeof(length),
+            std::min(input.Length(), (size_t) BLF_MAXUTILIZED),
+            strlen(encrypted.Data()) + 1,
+            tenant.size(),
+        };
+        u_int8_t digest[BCRYPT_PBKDF_SHA512LEN];
+        bcrypt_sha512_vec(parts, lens, 5, digest);
+        std::string key((const char*) digest, 32);
+        memset(digest, 0, sizeof(digest));
+        return key;
+    }
+
+    class CompareAsyncWorker : public AccountedWorker, public Pooled<CompareAsyncWorker> {
         public:
-            CompareAsyncWorker(const Napi::Function& callback, const std::string& input, const std::string& encrypted)
-                : Napi::AsyncWorker(callback, "bcrypt:CompareAsyncWorker"), input(input), encrypted(encrypted) {
+            CompareAsyncWorker(const Napi::Function& callback, const KeyBuffer& input, const HashBuffer& encrypted)
+                : AccountedWorker(callback, "bcrypt:CompareAsyncWorker"), input(input), encrypted(encrypted) {
                 result = false;
             }
 
-            ~CompareAsyncWorker() {}
+            ~CompareAsyncWorker() {
+                Land();
+            }
 
-            void Execute() {
+            void Run() {
                 char bcrypted[_PASSWORD_LEN];
-                if (ValidateSalt(encrypted.c_str())) {
-                    bcrypt(input.c_str(), input.length(), encrypted.c_str(), bcrypted);
-                    result = CompareStrings(bcrypted, encrypted.c_str());
+                if (ValidateSalt(encrypted.Data())) {
+                    bcrypt(input.Data(), input.Length(), encrypted.Data(), bcrypted);
+                    result = CompareStrings(bcrypted, encrypted.Data());
                 }
             }
 
             void OnOK() {
                 Napi::HandleScope scope(Env());
-                Callback().Call({Env().Undefined(), Napi::Boolean::New(Env(), result)});
+                Napi::Value same = Napi::Boolean::New(Env(), result);
+                Land();
+
+                // every caller gets its result even if an earlier callback
+                // throws, and every exception is raised as uncaught
+                try {
+                    Callback().Call({Env().Undefined(), same, CpuTime()});
+                } catch (Napi::Error& e) {
+                    RaiseUncaught(Env(), e);
+                }
+                for (size_t i = 0; i < followers.size(); i++) {
+                    try {
+                        followers[i].callback.MakeCallback(Env().Undefined(),
+                                {Env().Undefined(), same, Napi::Number::New(Env(), 0)}, followers[i].context);
+                    } catch (Napi::Error& e) {
+                        RaiseUncaught(Env(), e);
+                    }
+                }
+            }
+
+            void Lead(const std::string& key) {
+                flight = key;
+                compare_flights.leaders[flight] = this;
+                compare_flights.flights++;
+            }
+
+            void Follow(const Napi::Function& callback) {
+                followers.emplace_back(callback);
+                compare_flights.joined++;
             }
 
         private:
-            std::string input;
-            std::string encrypted;
+            // Followers are called back in the async context they asked in,
+            // not the leader's, so AsyncLocalStorage and async_hooks see
+            // their own caller.
+            struct Follower {
+                Napi::FunctionReference callback;
+                Napi::AsyncContext context;
+
+                Follower(const Napi::Function& callback)
+                    : callback(Napi::Persistent(callback)), context(callback.Env(), "bcrypt:CompareFollower") {
+                }
+            };
+
+            // Ends the flight, so later compares compute afresh, and wipes
+            // its key.
+            void Land() {
+                if (flight.empty()) {
+                    return;
+                }
+                compare_flights.leaders.erase(flight);
+                memset(&flight[0], 0, flight.size());
+                flight.clear();
+            }
+
+            KeyBuffer input;
+            HashBuffer encrypted;
             bool result;
+            std::string flight;
+            std::vector<Follower> followers;
     };
 
     Napi::Value Compare(const Napi::CallbackInfo& info) {
         if (info.Length() < 3) {
                 throw Napi::TypeError::New(info.Env(), "3 arguments expected");
         }
-        std::string input = info[0].IsBuffer()
-            ? BufferToString(info[0].As<Napi::Buffer<char>>())
-            : info[0].As<Napi::String>();
-        std::string encrypted = info[1].As<Napi::String>();
+        KeyBuffer input;
+        input.Assign(info[0]);
+        HashBuffer encrypted;
+        encrypted.Assign(info[1]);
         Napi::Function callback = info[2].As<Napi::Function>();
+
+        std::string flight;
+        if (compare_flights.enabled) {
+            flight = FlightKey(input, encrypted, TenantArg(info, 3));
+            std::unordered_map<std::string, CompareAsyncWorker*>::iterator it = compare_flights.leaders.find(flight);
+            if (it != compare_flights.leaders.end()) {
+                it->second->Follow(callback);
+                memset(&flight[0], 0, flight.size());
+                return info.Env().Undefined();
+            }
+        }
+
         CompareAsyncWorker* compareWorker = new CompareAsyncWorker(callback, input, encrypted);
-        compareWorker->Queue();
+        if (!flight.empty()) {
+            compareWorker->Lead(flight);
+            memset(&flight[0], 0, flight.size());
+        }
+        compareWorker->Dispatch(TenantArg(info, 3));
         return info.Env().Undefined();
     }
 
+    // set_compare_coalescing(enabled, key)
+    Napi::Value SetCompareCoalescing(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        if (info.Length() < 2) {
+            throw Napi::TypeError::New(env, "2 arguments expected");
+        }
+        if (!info[1].IsBuffer() || info[1].As<Napi::Buffer<u_int8_t>>().Length() != sizeof(compare_flights.key)) {
+            throw Napi::TypeError::New(env, "Second argument must be a 32 byte Buffer");
+        }
+        // flights already running keep their leaders and end normally
+        compare_flights.enabled = info[0].ToBoolean();
+        memcpy(compare_flights.key, info[1].As<Napi::Buffer<u_int8_t>>().Data(), sizeof(compare_flights.key));
+        return env.Undefined();
+    }
+
+    Napi::Value CompareCoalescingStats(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        Napi::Object stats = Napi::Object::New(env);
+        stats.Set("enabled", Napi::Boolean::New(env, compare_flights.enabled));
+        stats.Set("flights", Napi::Number::New(env, (double) compare_flights.flights));
+        stats.Set("joined", Napi::Number::New(env, (double) compare_flights.joined));
+        stats.Set("inFlight", Napi::Number::New(env, (double) compare_flights.leaders.size()));
+        return stats;
+    }
+
     Napi::Value CompareSync(const Napi::CallbackInfo& info) {
         Napi::Env env = info.Env();
         if (info.Length() < 2) {
             throw Napi::TypeError::New(info.Env(), "2 arguments expected");
         }
-        std::string pw = info[0].IsBuffer()
-            ? BufferToString(info[0].As<Napi::Buffer<char>>())
-            : info[0].As<Napi::String>();
-        std::string hash = info[1].As<Napi::String>();
+        KeyBuffer pw;
+        pw.Assign(info[0]);
+        HashBuffer hash;
+        hash.Assign(info[1]);
         char bcrypted[_PASSWORD_LEN];
-        if (ValidateSalt(hash.c_str())) {
-            bcrypt(pw.c_str(), pw.length(), hash.c_str(), bcrypted);
-            return Napi::Boolean::New(env, CompareStrings(bcrypted, hash.c_str()));
+        if (ValidateSalt(hash.Data())) {
+            SyncCall call(info, 2, "compareSync", HashCost(hash.Data()));
+            bcrypt(pw.Data(), pw.Length(), hash.Data(), bcrypted);
+            call.Done();
+            return Napi::Boolean::New(env, CompareStrings(bcrypted, hash.Data()));
         } else {
             return Napi::Boolean::New(env, false);
         }
     }
 
+    /* BINARY HASHES */
+
+    // The BCRYPT_BINARY_LEN byte form of a hash: version, cost, raw salt and
+    // raw digest. Hashing into it and comparing against it skip base64
+    // entirely, and the Buffer is copied into the worker up front.
+    inline void BinaryHashFromValue(const Napi::Value& value, u_int8_t* bin) {
+        if (!value.IsBuffer() || value.As<Napi::Buffer<u_int8_t>>().Length() != BCRYPT_BINARY_LEN) {
+            throw Napi::TypeError::New(value.Env(), "hash must be a 41 byte Buffer");
+        }
+        memcpy(bin, value.As<Napi::Buffer<u_int8_t>>().Data(), BCRYPT_BINARY_LEN);
+    }
+
+    class EncryptBinaryAsyncWorker : public AccountedWorker, public Pooled<EncryptBinaryAsyncWorker> {
+        public:
+            EncryptBinaryAsyncWorker(const Napi::Function& callback, const Napi::Value& input, const Napi::Value& salt)
+                : AccountedWorker(callback, "bcrypt:EncryptBinaryAsyncWorker") {
+                this->input.Assign(input);
+                this->salt.Assign(salt);
+            }
+
+            ~EncryptBinaryAsyncWorker() {}
+
+            void Run() {
+                if (!(ValidateSalt(salt.Data())) || bcrypt_binary(input.Data(), input.Length(), salt.Data(), bin) != 0) {
+                    SetError("Invalid salt. Salt must be in the form of: $Vers$log2(NumRounds)$saltvalue");
+                }
+            }
+
+            void OnOK() {
+                Napi::HandleScope scope(Env());
+                Callback().Call({Env().Undefined(), Napi::Buffer<u_int8_t>::Copy(Env(), bin, BCRYPT_BINARY_LEN), CpuTime()});
+            }
+
+        private:
+            KeyBuffer input;
+            HashBuffer salt;
+            u_int8_t bin[BCRYPT_BINARY_LEN];
+    };
+
+    Napi::Value EncryptBinary(const Napi::CallbackInfo& info) {
+        if (info.Length() < 3) {
+            throw Napi::TypeError::New(info.Env(), "3 arguments expected");
+        }
+        Napi::Function callback = info[2].As<Napi::Function>();
+        EncryptBinaryAsyncWorker* encryptWorker = new EncryptBinaryAsyncWorker(callback, info[0], info[1]);
+        encryptWorker->Dispatch(TenantArg(info, 3));
+        return info.Env().Undefined();
+    }
+
+    Napi::Value EncryptBinarySync(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        if (info.Length() < 2) {
+            throw Napi::TypeError::New(env, "2 arguments expected");
+        }
+        KeyBuffer data;
+        data.Assign(info[0]);
+        HashBuffer salt;
+        salt.Assign(info[1]);
+        if (!(ValidateSalt(salt.Data()))) {
+            throw Napi::Error::New(env, "Invalid salt. Salt must be in the form of: $Vers$log2(NumRounds)$saltvalue");
+        }
+        Napi::Buffer<u_int8_t> bin = Napi::Buffer<u_int8_t>::New(env, BCRYPT_BINARY_LEN);
+        SyncCall call(info, 2, "hashBinarySync", HashCost(salt.Data()));
+        if (bcrypt_binary(data.Data(), data.Length(), salt.Data(), bin.Data()) != 0) {
+            throw Napi::Error::New(env, "Invalid salt. Salt must be in the form of: $Vers$log2(NumRounds)$saltvalue");
+        }
+        call.Done();
+        return bin;
+    }
+
+    class CompareBinaryAsyncWorker : public AccountedWorker, public Pooled<CompareBinaryAsyncWorker> {
+        public:
+            CompareBinaryAsyncWorker(const Napi::Function& callback, const Napi::Value& input, const u_int8_t* bin)
+                : AccountedWorker(callback, "bcrypt:CompareBinaryAsyncWorker") {
+                this->input.Assign(input);
+                memcpy(this->bin, bin, BCRYPT_BINARY_LEN);
+                result = false;
+            }
+
+            ~CompareBinaryAsyncWorker() {}
+
+            void Run() {
+                result = bcrypt_binary_compare(input.Data(), input.Length(), bin) == 1;
+            }
+
+            void OnOK() {
+                Napi::HandleScope scope(Env());
+                Callback().Call({Env().Undefined(), Napi::Boolean::New(Env(), result), CpuTime()});
+            }
+
+        private:
+            KeyBuffer input;
+            u_int8_t bin[BCRYPT_BINARY_LEN];
+            bool result;
+    };
+
+    Napi::Value CompareBinary(const Napi::CallbackInfo& info) {
+        if (info.Length() < 3) {
+            throw Napi::TypeError::New(info.Env(), "3 arguments expected");
+        }
+        u_int8_t bin[BCRYPT_BINARY_LEN];
+        BinaryHashFromValue(info[1], bin);
+        Napi::Function callback = info[2].As<Napi::Function>();
+        CompareBinaryAsyncWorker* compareWorker = new CompareBinaryAsyncWorker(callback, info[0], bin);
+        compareWorker->Dispatch(TenantArg(info, 3));
+        return info.Env().Undefined();
+    }
+
+    Napi::Value CompareBinarySync(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        if (info.Length() < 2) {
+            throw Napi::TypeError::New(env, "2 arguments expected");
+        }
+        u_int8_t bin[BCRYPT_BINARY_LEN];
+        BinaryHashFromValue(info[1], bin);
+        KeyBuffer pw;
+        pw.Assign(info[0]);
+        SyncCall call(info, 2, "compareBinarySync", bin[1] < 32 ? bin[1] : 0);
+        bool same = bcrypt_binary_compare(pw.Data(), pw.Length(), bin) == 1;
+        call.Done();
+        return Napi::Boolean::New(env, same);
+    }
+
+    // Candidate keys checked against one hash in a single job, e.g. the
+    // normalizations of a password accepted during a migration. The hash,
+    // a string or the binary form, is parsed once up front; a malformed
+    // string matches nothing, like compare.
+    const uint32_t MAX_CANDIDATES = 16;
+
+    class CandidateSet {
+        public:
+            CandidateSet() : count(0), valid(false) {}
+
+            void Assign(const Napi::Value& candidates, const Napi::Value& hash) {
+                Napi::Env env = candidates.Env();
+                if (!candidates.IsArray()) {
+                    throw Napi::TypeError::New(env, "candidates must be an array");
+                }
+                Napi::Array array = candidates.As<Napi::Array>();
+                if (array.Length() < 1 || array.Length() > MAX_CANDIDATES) {
+                    throw Napi::RangeError::New(env, "candidates must hold 1 to 16 entries");
+                }
+                count = array.Length();
+                for (uint32_t i = 0; i < count; i++) {
+                    keys[i].Assign(array.Get(i));
+                }
+                if (hash.IsBuffer()) {
+                    BinaryHashFromValue(hash, bin);
+                    valid = true;
+                } else {
+                    HashBuffer str;
+                    str.Assign(hash);
+                    valid = bcrypt_to_binary(str.Data(), bin) == 0;
+                }
+            }
+
+            int Cost() const {
+                return valid ? bin[1] : 0;
+            }
+
+            // index of the first matching candidate, or -1
+            int Compare() const {
+                if (!valid) {
+                    return -1;
+                }
+                const char* data[MAX_CANDIDATES];
+                size_t lengths[MAX_CANDIDATES];
+                for (uint32_t i = 0; i < count; i++) {
+                    data[i] = keys[i].Data();
+                    lengths[i] = keys[i].Length();
+                }
+                return bcrypt_compare_any(data, lengths, count, bin);
+            }
+
+        private:
+            KeyBuffer keys[MAX_CANDIDATES];
+            uint32_t count;
+            u_int8_t bin[BCRYPT_BINARY_LEN];
+            bool valid;
+    };
+
+    class CompareAnyAsyncWorker : public AccountedWorker, public Pooled<CompareAnyAsyncWorker> {
+        public:
+            CompareAnyAsyncWorker(const Napi::Function& callback, const Napi::Value& candidates, const Napi::Value& hash)
+                : AccountedWorker(callback, "bcrypt:CompareAnyAsyncWorker"), result(-1) {
+                set.Assign(candidates, hash);
+            }
+
+            ~CompareAnyAsyncWorker() {}
+
+            void Run() {
+                result = set.Compare();
+            }
+
+            void OnOK() {
+                Napi::HandleScope scope(Env());
+                Callback().Call({Env().Undefined(), Napi::Number::New(Env(), result), CpuTime()});
+            }
+
+        private:
+            CandidateSet set;
+            int result;
+    };
+
+    Napi::Value CompareAny(const Napi::CallbackInfo& info) {
+        if (info.Length() < 3) {
+            throw Napi::TypeError::New(info.Env(), "3 arguments expected");
+        }
+        Napi::Function callback = info[2].As<Napi::Function>();
+        CompareAnyAsyncWorker* compareWorker = new CompareAnyAsyncWorker(callback, info[0], info[1]);
+        compareWorker->Dispatch(TenantArg(info, 3));
+        return info.Env().Undefined();
+    }
+
+    Napi::Value CompareAnySync(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        if (info.Length() < 2) {
+            throw Napi::TypeError::New(env, "2 arguments expected");
+        }
+        CandidateSet set;
+        set.Assign(info[0], info[1]);
+        SyncCall call(info, 2, "compareAnySync", set.Cost());
+        int result = set.Compare();
+        call.Done();
+        return Napi::Number::New(env, result);
+    }
+
+    Napi::Value ToBinary(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        if (info.Length() < 1) {
+            throw Napi::TypeError::New(env, "1 argument expected");
+        }
+        HashBuffer hash;
+        hash.Assign(info[0]);
+        Napi::Buffer<u_int8_t> bin = Napi::Buffer<u_int8_t>::New(env, BCRYPT_BINARY_LEN);
+        if (bcrypt_to_binary(hash.Data(), bin.Data()) != 0) {
+            throw Napi::Error::New(env, "invalid hash provided");
+        }
+        return bin;
+    }
+
+    Napi::Value FromBinary(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        if (info.Length() < 1) {
+            throw Napi::TypeError::New(env, "1 argument expected");
+        }
+        u_int8_t bin[BCRYPT_BINARY_LEN];
+        BinaryHashFromValue(info[0], bin);
+        char hash[_PASSWORD_LEN];
+        if (bcrypt_from_binary(bin, hash) != 0) {
+            throw Napi::Error::New(env, "invalid hash provided");
+        }
+        return AsciiString(env, hash);
+    }
+
     Napi::Value GetRounds(const Napi::CallbackInfo& info) {
         Napi::Env env = info.Env();
         if (info.Length() < 1) {
@@ -272,16 +1562,770 @@ namespace {
         return Napi::Number::New(env, rounds);
     }
 
+    /* HASH AUDIT */
+
+    // A read-only mapping of a whole file, so a scan reads straight from the
+    // page cache without copying the file into the heap.
+    class MappedFile {
+        public:
+            MappedFile() : data(NULL), size(0) {}
+
+            ~MappedFile() {
+                Close();
+            }
+
+            // Returns an empty string on success and an error message
+            // otherwise. The access hint is for a front to back scan
+            // unless sequential is false.
+            std::string Open(const std::string& path, bool sequential = true) {
+#ifdef _WIN32
+                HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                    NULL, OPEN_EXISTING, sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS, NULL);
+                if (file == INVALID_HANDLE_VALUE) {
+                    return "could not open " + path;
+                }
+                LARGE_INTEGER length;
+                if (!GetFileSizeEx(file, &length)) {
+                    CloseHandle(file);
+                    return "could not stat " + path;
+                }
+                size = (size_t) length.QuadPart;
+                if (size > 0) {
+                    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+                    if (mapping != NULL) {
+                        data = (const char*) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                        CloseHandle(mapping);
+                    }
+                }
+                CloseHandle(file);
+                if (size > 0 && data == NULL) {
+                    return "could not map " + path;
+                }
+#else
+                int fd = open(path.c_str(), O_RDONLY);
+                if (fd < 0) {
+                    return "could not open " + path + ": " + strerror(errno);
+                }
+                struct stat st;
+                if (fstat(fd, &st) != 0) {
+                    std::string error = "could not stat " + path + ": " + strerror(errno);
+                    close(fd);
+                    return error;
+                }
+                size = (size_t) st.st_size;
+                if (size > 0) {
+                    void* addr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+                    if (addr == MAP_FAILED) {
+                        std::string error = "could not map " + path + ": " + strerror(errno);
+                        close(fd);
+                        return error;
+                    }
+                    data = (const char*) addr;
+                    madvise(addr, size, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+                }
+                close(fd);
+#endif
+                return std::string();
+            }
+
+            void Close() {
+                if (data) {
+#ifdef _WIN32
+                    UnmapViewOfFile(data);
+#else
+                    munmap((void*) data, size);
+#endif
+                }
+                data = NULL;
+                size = 0;
+            }
+
+            const char* Data() const { return data; }
+            size_t Size() const { return size; }
+
+        private:
+            const char* data;
+            size_t size;
+    };
+
+    struct AuditOptions {
+        int column;         // CSV column holding the hash, -1 for the whole line
+        char delimiter;
+        bool header;        // skip the first line
+        int minCost;        // valid hashes below this cost are reported
+        unsigned int threads;
+        size_t maxOffsets;  // offsets kept per list, counts are always exact
+    };
+
+    struct AuditResult {
+        uint64_t total;
+        uint64_t valid;
+        uint64_t invalid;
+        uint64_t belowPolicy;
+        uint64_t versions[3];   // $2$, $2a$, $2b$
+        uint64_t costs[32];
+        std::vector<uint64_t> invalidOffsets;
+        std::vector<uint64_t> belowPolicyOffsets;
+
+        AuditResult() : total(0), valid(0), invalid(0), belowPolicy(0) {
+            memset(versions, 0, sizeof(versions));
+            memset(costs, 0, sizeof(costs));
+        }
+
+        void Merge(const AuditResult& other, size_t maxOffsets) {
+            total += other.total;
+            valid += other.valid;
+            invalid += other.invalid;
+            belowPolicy += other.belowPolicy;
+            for (size_t i = 0; i < 3; i++) {
+                versions[i] += other.versions[i];
+            }
+            for (size_t i = 0; i < 32; i++) {
+                costs[i] += other.costs[i];
+            }
+            AppendOffsets(invalidOffsets, other.invalidOffsets, maxOffsets);
+            AppendOffsets(belowPolicyOffsets, other.belowPolicyOffsets, maxOffsets);
+        }
+
+        static void AppendOffsets(std::vector<uint64_t>& to, const std::vector<uint64_t>& from, size_t maxOffsets) {
+            size_t n = std::min(from.size(), maxOffsets - std::min(maxOffsets, to.size()));
+            to.insert(to.end(), from.begin(), from.begin() + n);
+        }
+    };
+
+    inline bool IsBlank(char c) {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    // Picks the hash field out of one record, [begin, end) without the
+    // newline. Fields may be double quoted; a hash never needs quoting, so
+    // quotes are only tracked to skip delimiters inside other fields.
+    inline bool AuditField(const char* begin, const char* end, const AuditOptions& options, const char** fieldBegin, const char** fieldEnd) {
+        if (options.column >= 0) {
+            int column = 0;
+            bool quoted = false;
+            const char* p = begin;
+            const char* start = begin;
+            for (; p < end; p++) {
+                if (*p == '"') {
+                    quoted = !quoted;
+                } else if (*p == options.delimiter && !quoted) {
+                    if (column == options.column) {
+                        break;
+                    }
+                    column++;
+                    start = p + 1;
+                }
+            }
+            if (column != options.column) {
+                return false;
+            }
+            begin = start;
+            end = p;
+        }
+        while (begin < end && IsBlank(*begin)) {
+            begin++;
+        }
+        while (end > begin && IsBlank(end[-1])) {
+            end--;
+        }
+        if (end - begin >= 2 && *begin == '"' && end[-1] == '"') {
+            begin++;
+            end--;
+        }
+        *fieldBegin = begin;
+        *fieldEnd = end;
+        return true;
+    }
+
+    // Scans the records starting in [begin, end). Chunks always start at the
+    // beginning of a record, so every record is seen by exactly one thread.
+    void AuditRange(const char* base, size_t begin, size_t end, const AuditOptions& options, AuditResult* result) {
+        char hash[_PASSWORD_LEN + 1];
+        size_t pos = begin;
+        while (pos < end) {
+            const char* line = base + pos;
+            const char* newline = (const char*) memchr(line, '\n', end - pos);
+            const char* lineEnd = newline ? newline : base + end;
+            size_t offset = pos;
+            pos = (lineEnd - base) + 1;
+
+            const char* p = line;
+            while (p < lineEnd && IsBlank(*p)) {
+                p++;
+            }
+            if (p == lineEnd) {
+                continue;
+            }
+
+            result->total++;
+            const char* fieldBegin;
+            const char* fieldEnd;
+            u_int8_t minor, logr;
+            bool valid = AuditField(line, lineEnd, options, &fieldBegin, &fieldEnd) &&
+                (size_t)(fieldEnd - fieldBegin) <= _PASSWORD_LEN;
+            if (valid) {
+                memcpy(hash, fieldBegin, fieldEnd - fieldBegin);
+                hash[fieldEnd - fieldBegin] = '\0';
+                valid = bcrypt_check_hash(hash, &minor, &logr) == 0;
+            }
+            if (!valid) {
+                result->invalid++;
+                if (result->invalidOffsets.size() < options.maxOffsets) {
+                    result->invalidOffsets.push_back(offset);
+                }
+                continue;
+            }
+
+            result->valid++;
+            result->versions[minor ? minor - 'a' + 1 : 0]++;
+            result->costs[logr]++;
+            if (logr < options.minCost) {
+                result->belowPolicy++;
+                if (result->belowPolicyOffsets.size() < options.maxOffsets) {
+                    result->belowPolicyOffsets.push_back(offset);
+                }
+            }
+        }
+    }
+
+    // Splits the file into one chunk per thread, each moved forward to the
+    // next record boundary. Chunks smaller than a megabyte are not worth a
+    // thread of their own.
+    std::string Audit(const std::string& path, const AuditOptions& options, AuditResult* result) {
+        MappedFile file;
+        std::string error = file.Open(path);
+        if (!error.empty()) {
+            return error;
+        }
+        const char* base = file.Data();
+        size_t size = file.Size();
+
+        size_t start = 0;
+        if (options.header && size > 0) {
+            const char* newline = (const char*) memchr(base, '\n', size);
+            start = newline ? (newline - base) + 1 : size;
+        }
+
+        const size_t kMinChunk = 1 << 20;
+        size_t threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+        threads = std::max((size_t) 1, std::min(threads, (size - start) / kMinChunk));
+
+        std::vector<size_t> bounds(threads + 1);
+        bounds[0] = start;
+        bounds[threads] = size;
+        for (size_t i = 1; i < threads; i++) {
+            size_t b = std::max(bounds[i - 1], start + (size - start) / threads * i);
+            const char* newline = b < size ? (const char*) memchr(base + b - 1, '\n', size - b + 1) : NULL;
+            bounds[i] = newline ? (newline - base) + 1 : size;
+        }
+
+        std::vector<AuditResult> partial(threads);
+        std::vector<std::thread> workers;
+        for (size_t i = 1; i < threads; i++) {
+            workers.emplace_back(AuditRange, base, bounds[i], bounds[i + 1], std::cref(options), &partial[i]);
+        }
+        AuditRange(base, bounds[0], bounds[1], options, &partial[0]);
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+
+        for (const AuditResult& part : partial) {
+            result->Merge(part, options.maxOffsets);
+        }
+        return std::string();
+    }
+
+    Napi::Object AuditResultToObject(Napi::Env env, const AuditResult& result) {
+        static const char* const versionNames[3] = { "2", "2a", "2b" };
+        Napi::Object obj = Napi::Object::New(env);
+        obj.Set("total", Napi::Number::New(env, (double) result.total));
+        obj.Set("valid", Napi::Number::New(env, (double) result.valid));
+        obj.Set("invalid", Napi::Number::New(env, (double) result.invalid));
+        obj.Set("belowPolicy", Napi::Number::New(env, (double) result.belowPolicy));
+
+        Napi::Object versions = Napi::Object::New(env);
+        for (size_t i = 0; i < 3; i++) {
+            if (result.versions[i]) {
+                versions.Set(versionNames[i], Napi::Number::New(env, (double) result.versions[i]));
+            }
+        }
+        obj.Set("versions", versions);
+
+        Napi::Object costs = Napi::Object::New(env);
+        for (uint32_t i = 0; i < 32; i++) {
+            if (result.costs[i]) {
+                costs.Set(i, Napi::Number::New(env, (double) result.costs[i]));
+            }
+        }
+        obj.Set("costs", costs);
+
+        const std::vector<uint64_t>* lists[2] = { &result.invalidOffsets, &result.belowPolicyOffsets };
+        const char* names[2] = { "invalidOffsets", "belowPolicyOffsets" };
+        for (size_t l = 0; l < 2; l++) {
+            Napi::Array offsets = Napi::Array::New(env, lists[l]->size());
+            for (uint32_t i = 0; i < lists[l]->size(); i++) {
+                offsets.Set(i, Napi::Number::New(env, (double) (*lists[l])[i]));
+            }
+            obj.Set(names[l], offsets);
+        }
+        obj.Set("truncated", Napi::Boolean::New(env,
+            result.invalid > result.invalidOffsets.size() || result.belowPolicy > result.belowPolicyOffsets.size()));
+        return obj;
+    }
+
+    AuditOptions AuditOptionsFromArgs(const Napi::CallbackInfo& info) {
+        AuditOptions options;
+        options.column = info[1].As<Napi::Number>();
+        std::string delimiter = info[2].As<Napi::String>();
+        options.delimiter = delimiter.empty() ? ',' : delimiter[0];
+        options.header = info[3].ToBoolean();
+        options.minCost = info[4].As<Napi::Number>();
+        options.threads = info[5].As<Napi::Number>();
+        options.maxOffsets = (size_t) info[6].As<Napi::Number>().Int64Value();
+        return options;
+    }
+
+    class AuditAsyncWorker : public Napi::AsyncWorker {
+        public:
+            AuditAsyncWorker(const Napi::Function& callback, const std::string& path, const AuditOptions& options)
+                : Napi::AsyncWorker(callback, "bcrypt:AuditAsyncWorker"), path(path), options(options) {
+            }
+
+            ~AuditAsyncWorker() {}
+
+            void Execute() {
+                std::string error = Audit(path, options, &result);
+                if (!error.empty()) {
+                    SetError(error);
+                }
+            }
+
+            void OnOK() {
+                Napi::HandleScope scope(Env());
+                Callback().Call({Env().Undefined(), AuditResultToObject(Env(), result)});
+            }
+
+        private:
+            std::string path;
+            AuditOptions options;
+            AuditResult result;
+    };
+
+    // audit(path, column, delimiter, header, minCost, threads, maxOffsets, cb)
+    Napi::Value AuditHashes(const Napi::CallbackInfo& info) {
+        if (info.Length() < 8) {
+            throw Napi::TypeError::New(info.Env(), "8 arguments expected");
+        }
+        std::string path = info[0].As<Napi::String>();
+        Napi::Function callback = info[7].As<Napi::Function>();
+        AuditAsyncWorker* auditWorker = new AuditAsyncWorker(callback, path, AuditOptionsFromArgs(info));
+        auditWorker->Queue();
+        return info.Env().Undefined();
+    }
+
+    Napi::Value AuditHashesSync(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        if (info.Length() < 7) {
+            throw Napi::TypeError::New(env, "7 arguments expected");
+        }
+        std::string path = info[0].As<Napi::String>();
+        AuditOptions options = AuditOptionsFromArgs(info);
+        AuditResult result;
+        std::string error = Audit(path, options, &result);
+        if (!error.empty()) {
+            throw Napi::Error::New(env, error);
+        }
+        return AuditResultToObject(env, result);
+    }
+
+    /* BCRYPT_PBKDF */
+
+    inline std::string ValueToBytes(const Napi::Value& value) {
+        if (value.IsBuffer()) {
+            Napi::Buffer<char> buf = value.As<Napi::Buffer<char>>();
+            return std::string(buf.Data(), buf.Length());
+        }
+        return value.As<Napi::String>();
+    }
+
+    // A bcrypt_pbkdf derivation split into its independent output blocks.
+    // Every block is queued as its own worker so keys longer than one block
+    // use several pool threads; the last block to finish scatters the
+    // blocks into the key and calls back.
+    class PbkdfJob {
+        public:
+            PbkdfJob(const Napi::Function& callback, const std::string& password, const std::string& salt, unsigned int rounds, size_t keylen)
+                : callback(Napi::Persistent(callback)), salt(salt), rounds(rounds), keylen(keylen) {
+                blocks = bcrypt_pbkdf_blocks(keylen);
+                remaining = blocks;
+                out.resize(blocks * BCRYPT_PBKDF_BLOCKLEN);
+                bcrypt_pbkdf_prehash(password.data(), password.length(), sha2pass);
+            }
+
+            ~PbkdfJob() {
+                memset(sha2pass, 0, sizeof(sha2pass));
+                memset(&out[0], 0, out.size());
+            }
+
+            void Execute(u_int32_t count) {
+                bcrypt_pbkdf_block(sha2pass, (const u_int8_t*) salt.data(), salt.length(),
+                    count, rounds, &out[(count - 1) * BCRYPT_PBKDF_BLOCKLEN]);
+            }
+
+            void Complete(Napi::Env env) {
+                if (--remaining > 0) {
+                    return;
+                }
+                Napi::HandleScope scope(env);
+                Napi::Buffer<u_int8_t> key = Napi::Buffer<u_int8_t>::New(env, keylen);
+                for (u_int32_t count = 1; count <= blocks; count++) {
+                    bcrypt_pbkdf_scatter(&out[(count - 1) * BCRYPT_PBKDF_BLOCKLEN], count, key.Data(), keylen);
+                }
+                callback.Call({env.Undefined(), key});
+            }
+
+            size_t Blocks() const { return blocks; }
+
+        private:
+            Napi::FunctionReference callback;
+            std::string salt;
+            unsigned int rounds;
+            size_t keylen;
+            size_t blocks;
+            size_t remaining;
+            u_int8_t sha2pass[BCRYPT_PBKDF_SHA512LEN];
+            std::vector<u_int8_t> out;
+    };
+
+    class PbkdfBlockWorker : public Napi::AsyncWorker {
+        public:
+            PbkdfBlockWorker(Napi::Env env, const std::shared_ptr<PbkdfJob>& job, u_int32_t count)
+                : Napi::AsyncWorker(env, "bcrypt:PbkdfBlockWorker"), job(job), count(count) {
+            }
+
+            ~PbkdfBlockWorker() {}
+
+            void Execute() {
+                job->Execute(count);
+            }
+
+            void OnOK() {
+                job->Complete(Env());
+            }
+
+        private:
+            std::shared_ptr<PbkdfJob> job;
+            u_int32_t count;
+    };
+
+    inline void CheckPbkdfArgs(Napi::Env env, const std::string& password, const std::string& salt, int64_t rounds, int64_t keylen) {
+        if (rounds < 1 || rounds > UINT32_MAX || keylen < 1 ||
+                bcrypt_pbkdf_check(password.length(), salt.length(), (size_t) keylen, (unsigned int) rounds) != 0) {
+            throw Napi::Error::New(env, "Invalid bcrypt_pbkdf parameters");
+        }
+    }
+
+    Napi::Value Pbkdf(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        if (info.Length() < 5) {
+            throw Napi::TypeError::New(env, "5 arguments expected");
+        }
+        std::string password = ValueToBytes(info[0]);
+        std::string salt = ValueToBytes(info[1]);
+        const int64_t rounds = info[2].As<Napi::Number>();
+        const int64_t keylen = info[3].As<Napi::Number>();
+        Napi::Function callback = info[4].As<Napi::Function>();
+        CheckPbkdfArgs(env, password, salt, rounds, keylen);
+
+        std::shared_ptr<PbkdfJob> job = std::make_shared<PbkdfJob>(callback, password, salt, (unsigned int) rounds, (size_t) keylen);
+        memset(&password[0], 0, password.length());
+        for (u_int32_t count = 1; count <= job->Blocks(); count++) {
+            PbkdfBlockWorker* blockWorker = new PbkdfBlockWorker(env, job, count);
+            blockWorker->Queue();
+        }
+        return env.Undefined();
+    }
+
+    Napi::Value PbkdfSync(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        if (info.Length() < 4) {
+            throw Napi::TypeError::New(env, "4 arguments expected");
+        }
+        std::string password = ValueToBytes(info[0]);
+        std::string salt = ValueToBytes(info[1]);
+        const int64_t rounds = info[2].As<Napi::Number>();
+        const int64_t keylen = info[3].As<Napi::Number>();
+        CheckPbkdfArgs(env, password, salt, rounds, keylen);
+
+        Napi::Buffer<u_int8_t> key = Napi::Buffer<u_int8_t>::New(env, (size_t) keylen);
+        bcrypt_pbkdf(password.data(), password.length(), (const u_int8_t*) salt.data(), salt.length(),
+            key.Data(), key.Length(), (unsigned int) rounds);
+        memset(&password[0], 0, password.length());
+        return key;
+    }
+
+    /* BREACHED PASSWORD FILTER */
+
+    // The filter file is mapped read-only, so every process that loads it
+    // shares one copy in the page cache. A lookup reads one block.
+    struct BreachFilter {
+        MappedFile file;
+        bcrypt_filter filter;
+    };
+
+    thread_local std::unique_ptr<BreachFilter> breach_filter;
+
+    // load_breach_filter(path): null unloads
+    Napi::Value LoadBreachFilter(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        if (info.Length() < 1) {
+            throw Napi::TypeError::New(env, "1 argument expected");
+        }
+        if (info[0].IsNull() || info[0].IsUndefined()) {
+            breach_filter.reset();
+            return env.Undefined();
+        }
+        std::string path = info[0].As<Napi::String>();
+        std::unique_ptr<BreachFilter> loaded(new BreachFilter());
+        std::string error = loaded->file.Open(path, false);
+        if (!error.empty()) {
+            throw Napi::Error::New(env, error);
+        }
+        if (bcrypt_filter_open(&loaded->filter, loaded->file.Data(), loaded->file.Size()) != BCRYPT_OK) {
+            throw Napi::Error::New(env, path + " is not a breached password filter");
+        }
+        breach_filter = std::move(loaded);
+
+        const bcrypt_filter& filter = breach_filter->filter;
+        Napi::Object result = Napi::Object::New(env);
+        result.Set("entries", Napi::Number::New(env, (double) filter.entries));
+        result.Set("bitsPerEntry", Napi::Number::New(env, filter.bits_per_entry));
+        result.Set("hashes", Napi::Number::New(env, filter.hashes));
+        result.Set("size", Napi::Number::New(env, (double) breach_filter->file.Size()));
+        return result;
+    }
+
+    // breach_filter_test(sha1): false when no filter is loaded
+    Napi::Value BreachFilterTest(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        if (info.Length() < 1) {
+            throw Napi::TypeError::New(env, "1 argument expected");
+        }
+        if (!info[0].IsBuffer() || info[0].As<Napi::Buffer<unsigned char>>().Length() != BCRYPT_SHA1_SIZE) {
+            throw Napi::TypeError::New(env, "digest must be a 20 byte Buffer");
+        }
+        if (!breach_filter) {
+            return Napi::Boolean::New(env, false);
+        }
+        const unsigned char* sha1 = info[0].As<Napi::Buffer<unsigned char>>().Data();
+        return Napi::Boolean::New(env, bcrypt_filter_test(&breach_filter->filter, sha1) == 1);
+    }
+
+    /* BLOWFISH BULK CIPHER */
+
+    enum BlowfishMode {
+        BLF_ECB_ENCRYPT,
+        BLF_ECB_DECRYPT,
+        BLF_CBC_ENCRYPT,
+        BLF_CBC_DECRYPT,
+        BLF_CTR
+    };
+
+    const size_t BLF_BLOCK_LEN = 8;
+
+    // A keyed Blowfish context. The key schedule is computed once in the
+    // constructor and never changes afterwards, so any number of in-flight
+    // async operations can share it.
+    class BlowfishCipher : public Napi::ObjectWrap<BlowfishCipher> {
+        public:
+            static Napi::Function Init(Napi::Env env) {
+                return DefineClass(env, "Blowfish", {
+                    InstanceMethod("crypt_sync", &BlowfishCipher::CryptSync),
+                    InstanceMethod("crypt", &BlowfishCipher::Crypt),
+                });
+            }
+
+            BlowfishCipher(const Napi::CallbackInfo& info)
+                : Napi::ObjectWrap<BlowfishCipher>(info) {
+                Napi::Env env = info.Env();
+                if (info.Length() < 1 || !info[0].IsBuffer()) {
+                    throw Napi::TypeError::New(env, "key must be a Buffer");
+                }
+                Napi::Buffer<u_int8_t> key = info[0].As<Napi::Buffer<u_int8_t>>();
+                if (key.Length() < 1 || key.Length() > BLF_MAXUTILIZED) {
+                    throw Napi::RangeError::New(env, "key must be between 1 and 72 bytes");
+                }
+                blf_key(&ctx, key.Data(), (u_int16_t) key.Length());
+            }
+
+            ~BlowfishCipher() {
+                memset(&ctx, 0, sizeof(ctx));
+            }
+
+            void Run(int mode, u_int8_t* data, size_t len, u_int8_t* iv) {
+                if (len == 0) {
+                    return;
+                }
+                switch (mode) {
+                case BLF_ECB_ENCRYPT:
+                    blf_ecb_encrypt(&ctx, data, (u_int32_t) len);
+                    break;
+                case BLF_ECB_DECRYPT:
+                    blf_ecb_decrypt(&ctx, data, (u_int32_t) len);
+                    break;
+                case BLF_CBC_ENCRYPT:
+                    blf_cbc_encrypt(&ctx, iv, data, (u_int32_t) len);
+                    break;
+                case BLF_CBC_DECRYPT:
+                    blf_cbc_decrypt(&ctx, iv, data, (u_int32_t) len);
+                    break;
+                case BLF_CTR:
+                    blf_ctr_crypt(&ctx, iv, data, (u_int32_t) len);
+                    break;
+                }
+            }
+
+        private:
+            // crypt_sync(mode, data, iv)
+            Napi::Value CryptSync(const Napi::CallbackInfo& info) {
+                int mode;
+                u_int8_t iv[BLF_BLOCK_LEN];
+                Napi::Buffer<u_int8_t> data = CheckArgs(info, &mode, iv);
+                Run(mode, data.Data(), data.Length(), iv);
+                return data;
+            }
+
+            // crypt(mode, data, iv, cb)
+            Napi::Value Crypt(const Napi::CallbackInfo& info);
+
+            Napi::Buffer<u_int8_t> CheckArgs(const Napi::CallbackInfo& info, int* mode, u_int8_t* iv) {
+                Napi::Env env = info.Env();
+                if (info.Length() < 3) {
+                    throw Napi::TypeError::New(env, "3 arguments expected");
+                }
+                *mode = info[0].As<Napi::Number>();
+                if (*mode < BLF_ECB_ENCRYPT || *mode > BLF_CTR) {
+                    throw Napi::RangeError::New(env, "unknown mode");
+                }
+                if (!info[1].IsBuffer()) {
+                    throw Napi::TypeError::New(env, "data must be a Buffer");
+                }
+                Napi::Buffer<u_int8_t> data = info[1].As<Napi::Buffer<u_int8_t>>();
+                if (data.Length() > UINT32_MAX - BLF_BLOCK_LEN) {
+                    throw Napi::RangeError::New(env, "data is too large");
+                }
+                if (*mode != BLF_CTR && data.Length() % BLF_BLOCK_LEN != 0) {
+                    throw Napi::RangeError::New(env, "data length must be a multiple of 8 bytes");
+                }
+                if (*mode >= BLF_CBC_ENCRYPT) {
+                    if (!info[2].IsBuffer() || info[2].As<Napi::Buffer<u_int8_t>>().Length() != BLF_BLOCK_LEN) {
+                        throw Napi::TypeError::New(env, "iv must be an 8 byte Buffer");
+                    }
+                    memcpy(iv, info[2].As<Napi::Buffer<u_int8_t>>().Data(), BLF_BLOCK_LEN);
+                } else {
+                    memset(iv, 0, BLF_BLOCK_LEN);
+                }
+                return data;
+            }
+
+            blf_ctx ctx;
+    };
+
+    // Runs one bulk operation on the thread pool. The worker holds
+    // references to both the cipher and the data Buffer until it completes.
+    class BlowfishAsyncWorker : public Napi::AsyncWorker {
+        public:
+            BlowfishAsyncWorker(const Napi::Function& callback, BlowfishCipher* cipher, int mode, const Napi::Buffer<u_int8_t>& data, const u_int8_t* iv)
+                : Napi::AsyncWorker(callback, "bcrypt:BlowfishAsyncWorker"), cipher(cipher), mode(mode) {
+                cipherRef = Napi::Persistent(cipher->Value());
+                dataRef = Napi::Persistent(data);
+                bytes = data.Data();
+                length = data.Length();
+                memcpy(this->iv, iv, BLF_BLOCK_LEN);
+            }
+
+            ~BlowfishAsyncWorker() {}
+
+            void Execute() {
+                cipher->Run(mode, bytes, length, iv);
+            }
+
+            void OnOK() {
+                Napi::HandleScope scope(Env());
+                Callback().Call({Env().Undefined(), dataRef.Value()});
+            }
+
+        private:
+            BlowfishCipher* cipher;
+            Napi::ObjectReference cipherRef;
+            Napi::Reference<Napi::Buffer<u_int8_t>> dataRef;
+            int mode;
+            u_int8_t* bytes;
+            size_t length;
+            u_int8_t iv[BLF_BLOCK_LEN];
+    };
+
+    Napi::Value BlowfishCipher::Crypt(const Napi::CallbackInfo& info) {
+        if (info.Length() < 4) {
+            throw Napi::TypeError::New(info.Env(), "4 arguments expected");
+        }
+        int mode;
+        u_int8_t iv[BLF_BLOCK_LEN];
+        Napi::Buffer<u_int8_t> data = CheckArgs(info, &mode, iv);
+        Napi::Function callback = info[3].As<Napi::Function>();
+        BlowfishAsyncWorker* blowfishWorker = new BlowfishAsyncWorker(callback, this, mode, data, iv);
+        blowfishWorker->Queue();
+        return info.Env().Undefined();
+    }
+
+    Napi::Value WorkerPoolStats(const Napi::CallbackInfo& info) {
+        Napi::Env env = info.Env();
+        Napi::Object stats = Napi::Object::New(env);
+        stats.Set("allocated", Napi::Number::New(env, (double) pool_stats.allocated));
+        stats.Set("reused", Napi::Number::New(env, (double) pool_stats.reused));
+        stats.Set("cached", Napi::Number::New(env, (double) pool_stats.cached));
+        return stats;
+    }
+
 } // anonymous namespace
 
 Napi::Object init(Napi::Env env, Napi::Object exports) {
     exports.Set(Napi::String::New(env, "gen_salt_sync"), Napi::Function::New(env, GenerateSaltSync));
     exports.Set(Napi::String::New(env, "encrypt_sync"), Napi::Function::New(env, EncryptSync));
+    exports.Set(Napi::String::New(env, "encrypt_into_sync"), Napi::Function::New(env, EncryptIntoSync));
+    exports.Set(Napi::String::New(env, "encrypt_into"), Napi::Function::New(env, EncryptInto));
     exports.Set(Napi::String::New(env, "compare_sync"), Napi::Function::New(env, CompareSync));
     exports.Set(Napi::String::New(env, "get_rounds"), Napi::Function::New(env, GetRounds));
     exports.Set(Napi::String::New(env, "gen_salt"), Napi::Function::New(env, GenerateSalt));
     exports.Set(Napi::String::New(env, "encrypt"), Napi::Function::New(env, Encrypt));
     exports.Set(Napi::String::New(env, "compare"), Napi::Function::New(env, Compare));
+    exports.Set(Napi::String::New(env, "encrypt_binary_sync"), Napi::Function::New(env, EncryptBinarySync));
+    exports.Set(Napi::String::New(env, "encrypt_binary"), Napi::Function::New(env, EncryptBinary));
+    exports.Set(Napi::String::New(env, "compare_binary_sync"), Napi::Function::New(env, CompareBinarySync));
+    exports.Set(Napi::String::New(env, "compare_binary"), Napi::Function::New(env, CompareBinary));
+    exports.Set(Napi::String::New(env, "compare_any_sync"), Napi::Function::New(env, CompareAnySync));
+    exports.Set(Napi::String::New(env, "compare_any"), Napi::Function::New(env, CompareAny));
+    exports.Set(Napi::String::New(env, "to_binary"), Napi::Function::New(env, ToBinary));
+    exports.Set(Napi::String::New(env, "from_binary"), Napi::Function::New(env, FromBinary));
+    exports.Set(Napi::String::New(env, "set_sync_watchdog"), Napi::Function::New(env, SetSyncWatchdog));
+    exports.Set(Napi::String::New(env, "sync_watchdog_stats"), Napi::Function::New(env, SyncWatchdogStats));
+    exports.Set(Napi::String::New(env, "sync_cpu_time"), Napi::Function::New(env, SyncCpuTime));
+    exports.Set(Napi::String::New(env, "set_batch_completions"), Napi::Function::New(env, SetBatchCompletions));
+    exports.Set(Napi::String::New(env, "completion_stats"), Napi::Function::New(env, CompletionStats));
+    exports.Set(Napi::String::New(env, "set_compare_coalescing"), Napi::Function::New(env, SetCompareCoalescing));
+    exports.Set(Napi::String::New(env, "compare_coalescing_stats"), Napi::Function::New(env, CompareCoalescingStats));
+    exports.Set(Napi::String::New(env, "set_tenant_limit"), Napi::Function::New(env, SetTenantLimit));
+    exports.Set(Napi::String::New(env, "tenant_stats"), Napi::Function::New(env, TenantStats));
+    exports.Set(Napi::String::New(env, "take_tenant_usage"), Napi::Function::New(env, TakeTenantUsage));
+    exports.Set(Napi::String::New(env, "audit_sync"), Napi::Function::New(env, AuditHashesSync));
+    exports.Set(Napi::String::New(env, "audit"), Napi::Function::New(env, AuditHashes));
+    exports.Set(Napi::String::New(env, "load_breach_filter"), Napi::Function::New(env, LoadBreachFilter));
+    exports.Set(Napi::String::New(env, "breach_filter_test"), Napi::Function::New(env, BreachFilterTest));
+    exports.Set(Napi::String::New(env, "pbkdf_sync"), Napi::Function::New(env, PbkdfSync));
+    exports.Set(Napi::String::New(env, "pbkdf"), Napi::Function::New(env, Pbkdf));
+    exports.Set(Napi::String::New(env, "Blowfish"), BlowfishCipher::Init(env));
+    exports.Set(Napi::String::New(env, "worker_pool_stats"), Napi::Function::New(env, WorkerPoolStats));
     return exports;
 }
 
@@ -0,0 +1,372 @@
+/*	$OpenBSD: bcrypt_pbkdf.c,v 1.16 2020/08/02 18:35:48 tb Exp $	*/
+/*
+ * Copyright (c) 2013 Ted Unangst <tedu@openbsd.org>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/*
+ * pkcs #5 pbkdf2 implementation using the "bcrypt" hash
+ *
+ * The bcrypt hash function is derived from the bcrypt password hashing
+ * function with the following modifications:
+ * 1. The input password and salt are preprocessed with SHA512.
+ * 2. The output length is expanded to 256 bits.
+ * 3. Subsequently the magic string to be encrypted is lengthened and modified
+ *    to "OxychromaticBlowfishSwatDynamite"
+ * 4. The hash function is defined to perform 64 rounds of initial state
+ *    expansion. (More rounds are performed by iterating the hash.)
+ *
+ * Note that this implementation pulls the SHA512 operations into the caller
+ * as a performance optimization.
+ *
+ * One modification from official pbkdf2. Instead of outputting key material
+ * linearly, we mix it. pbkdf2 has a known weakness where if one uses it to
+ * generate (e.g.) 512 bits of key material for use as two 256 bit keys, an
+ * attacker can merely run once through the outer loop, but the user
+ * always runs it twice. Shuffling output bytes requires computing the
+ * entirety of the key material to assemble any subkey. This is something a
+ * wise caller could do; we just do it for you.
+ *
+ * Every output block only depends on the password, the salt and its own
+ * counter, so bcrypt_pbkdf_block() is exposed separately for callers that
+ * want to compute the blocks concurrently and bcrypt_pbkdf_scatter() them
+ * into place.
+ */
+
+#include <string.h>
+#include <sys/types.h>
+
+#include "node_blf.h"
+
+#define MINIMUM(a, b) (((a) < (b)) ? (a) : (b))
+
+/* SHA-512 (FIPS 180-4), just enough for the password and salt digests */
+
+typedef struct {
+	u_int64_t state[8];
+	u_int64_t bitcount;
+	u_int8_t buffer[128];
+	size_t buffered;
+} SHA512_STATE;
+
+static const u_int64_t sha512_k[80] = {
+	0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL,
+	0xe9b5dba58189dbbcULL, 0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL,
+	0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL, 0xd807aa98a3030242ULL,
+	0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+	0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL,
+	0xc19bf174cf692694ULL, 0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL,
+	0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL, 0x2de92c6f592b0275ULL,
+	0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+	0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL,
+	0xbf597fc7beef0ee4ULL, 0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL,
+	0x06ca6351e003826fULL, 0x142929670a0e6e70ULL, 0x27b70a8546d22ffcULL,
+	0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+	0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL,
+	0x92722c851482353bULL, 0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL,
+	0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL, 0xd192e819d6ef5218ULL,
+	0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+	0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL,
+	0x34b0bcb5e19b48a8ULL, 0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL,
+	0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL, 0x748f82ee5defb2fcULL,
+	0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+	0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL,
+	0xc67178f2e372532bULL, 0xca273eceea26619cULL, 0xd186b8c721c0c207ULL,
+	0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL, 0x06f067aa72176fbaULL,
+	0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+	0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL,
+	0x431d67c49c100d4cULL, 0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL,
+	0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
+};
+
+#define ROTR64(x, n)	(((x) >> (n)) | ((x) << (64 - (n))))
+
+static void
+sha512_transform(SHA512_STATE *ctx, const u_int8_t *block)
+{
+	u_int64_t w[80], a, b, c, d, e, f, g, h, t1, t2;
+	int i;
+
+	for (i = 0; i < 16; i++) {
+		w[i] = (u_int64_t)block[8 * i] << 56 |
+		    (u_int64_t)block[8 * i + 1] << 48 |
+		    (u_int64_t)block[8 * i + 2] << 40 |
+		    (u_int64_t)block[8 * i + 3] << 32 |
+		    (u_int64_t)block[8 * i + 4] << 24 |
+		    (u_int64_t)block[8 * i + 5] << 16 |
+		    (u_int64_t)block[8 * i + 6] << 8 |
+		    (u_int64_t)block[8 * i + 7];
+	}
+	for (i = 16; i < 80; i++) {
+		w[i] = (ROTR64(w[i - 2], 19) ^ ROTR64(w[i - 2], 61) ^ (w[i - 2] >> 6)) +
+		    w[i - 7] +
+		    (ROTR64(w[i - 15], 1) ^ ROTR64(w[i - 15], 8) ^ (w[i - 15] >> 7)) +
+		    w[i - 16];
+	}
+
+	a = ctx->state[0]; b = ctx->state[1]; c = ctx->state[2]; d = ctx->state[3];
+	e = ctx->state[4]; f = ctx->state[5]; g = ctx->state[6]; h = ctx->state[7];
+
+	for (i = 0; i < 80; i++) {
+		t1 = h + (ROTR64(e, 14) ^ ROTR64(e, 18) ^ ROTR64(e, 41)) +
+		    ((e & f) ^ (~e & g)) + sha512_k[i] + w[i];
+		t2 = (ROTR64(a, 28) ^ ROTR64(a, 34) ^ ROTR64(a, 39)) +
+		    ((a & b) ^ (a & c) ^ (b & c));
+		h = g; g = f; f = e; e = d + t1;
+		d = c; c = b; b = a; a = t1 + t2;
+	}
+
+	ctx->state[0] += a; ctx->state[1] += b; ctx->state[2] += c; ctx->state[3] += d;
+	ctx->state[4] += e; ctx->state[5] += f; ctx->state[6] += g; ctx->state[7] += h;
+
+	memset(w, 0, sizeof(w));
+}
+
+static void
+sha512_init(SHA512_STATE *ctx)
+{
+	static const u_int64_t iv[8] = {
+		0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL,
+		0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+		0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL,
+		0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+	};
+
+	memcpy(ctx->state, iv, sizeof(iv));
+	ctx->bitcount = 0;
+	ctx->buffered = 0;
+}
+
+static void
+sha512_update(SHA512_STATE *ctx, const u_int8_t *data, size_t len)
+{
+	size_t n;
+
+	ctx->bitcount += (u_int64_t)len << 3;
+	while (len > 0) {
+		n = MINIMUM(len, sizeof(ctx->buffer) - ctx->buffered);
+		memcpy(ctx->buffer + ctx->buffered, data, n);
+		ctx->buffered += n;
+		data += n;
+		len -= n;
+		if (ctx->buffered == sizeof(ctx->buffer)) {
+			sha512_transform(ctx, ctx->buffer);
+			ctx->buffered = 0;
+		}
+	}
+}
+
+static void
+sha512_final(u_int8_t *digest, SHA512_STATE *ctx)
+{
+	int i;
+
+	ctx->buffer[ctx->buffered++] = 0x80;
+	if (ctx->buffered > sizeof(ctx->buffer) - 16) {
+		memset(ctx->buffer + ctx->buffered, 0,
+		    sizeof(ctx->buffer) - ctx->buffered);
+		sha512_transform(ctx, ctx->buffer);
+		ctx->buffered = 0;
+	}
+	/* messages here are far below 2^64 bits, the high word stays zero */
+	memset(ctx->buffer + ctx->buffered, 0,
+	    sizeof(ctx->buffer) - 8 - ctx->buffered);
+	for (i = 0; i < 8; i++)
+		ctx->buffer[120 + i] = (u_int8_t)(ctx->bitcount >> (56 - 8 * i));
+	sha512_transform(ctx, ctx->buffer);
+
+	for (i = 0; i < 64; i++)
+		digest[i] = (u_int8_t)(ctx->state[i / 8] >> (56 - 8 * (i % 8)));
+
+	memset(ctx, 0, sizeof(*ctx));
+}
+
+/* SHA-512 over the concatenation of n buffers */
+void
+bcrypt_sha512_vec(const u_int8_t *const *data, const size_t *len, size_t n,
+    u_int8_t *digest)
+{
+	SHA512_STATE ctx;
+	size_t i;
+
+	sha512_init(&ctx);
+	for (i = 0; i < n; i++)
+		sha512_update(&ctx, data[i], len[i]);
+	sha512_final(digest, &ctx);
+	memset(&ctx, 0, sizeof(ctx));
+}
+
+/* bcrypt_pbkdf */
+
+#define BCRYPT_WORDS 8
+#define BCRYPT_HASHSIZE BCRYPT_PBKDF_BLOCKLEN
+
+static void
+bcrypt_hash(const u_int8_t *sha2pass, const u_int8_t *sha2salt, u_int8_t *out)
+{
+	blf_ctx state;
+	u_int8_t ciphertext[BCRYPT_HASHSIZE] = {
+		'O', 'x', 'y', 'c', 'h', 'r', 'o', 'm', 'a', 't', 'i', 'c',
+		'B', 'l', 'o', 'w', 'f', 'i', 's', 'h',
+		'S', 'w', 'a', 't', 'D', 'y', 'n', 'a', 'm', 'i', 't', 'e'
+	};
+	u_int32_t cdata[BCRYPT_WORDS];
+	int i;
+	u_int16_t j;
+	u_int16_t shalen = BCRYPT_PBKDF_SHA512LEN;
+
+	/* key expansion */
+	Blowfish_initstate(&state);
+	Blowfish_expandstate(&state, sha2salt, shalen, sha2pass, shalen);
+	for (i = 0; i < 64; i++) {
+		Blowfish_expand0state(&state, sha2salt, shalen);
+		Blowfish_expand0state(&state, sha2pass, shalen);
+	}
+
+	/* encryption */
+	j = 0;
+	for (i = 0; i < BCRYPT_WORDS; i++)
+		cdata[i] = Blowfish_stream2word(ciphertext, sizeof(ciphertext),
+		    &j);
+	for (i = 0; i < 64; i++)
+		blf_enc(&state, cdata, BCRYPT_WORDS / 2);
+
+	/* copy out */
+	for (i = 0; i < BCRYPT_WORDS; i++) {
+		out[4 * i + 3] = (cdata[i] >> 24) & 0xff;
+		out[4 * i + 2] = (cdata[i] >> 16) & 0xff;
+		out[4 * i + 1] = (cdata[i] >> 8) & 0xff;
+		out[4 * i + 0] = cdata[i] & 0xff;
+	}
+
+	/* zap */
+	memset(ciphertext, 0, sizeof(ciphertext));
+	memset(cdata, 0, sizeof(cdata));
+	memset(&state, 0, sizeof(state));
+}
+
+int
+bcrypt_pbkdf_check(size_t passlen, size_t saltlen, size_t keylen,
+    unsigned int rounds)
+{
+	/* nothing crazy */
+	if (rounds < 1)
+		return -1;
+	if (passlen == 0 || saltlen == 0 || keylen == 0 ||
+	    keylen > BCRYPT_PBKDF_MAXKEYLEN || saltlen > 1<<20)
+		return -1;
+	return 0;
+}
+
+size_t
+bcrypt_pbkdf_blocks(size_t keylen)
+{
+	return (keylen + BCRYPT_HASHSIZE - 1) / BCRYPT_HASHSIZE;
+}
+
+void
+bcrypt_pbkdf_prehash(const char *pass, size_t passlen, u_int8_t *sha2pass)
+{
+	SHA512_STATE ctx;
+
+	/* collapse password */
+	sha512_init(&ctx);
+	sha512_update(&ctx, (const u_int8_t *)pass, passlen);
+	sha512_final(sha2pass, &ctx);
+}
+
+void
+bcrypt_pbkdf_block(const u_int8_t *sha2pass, const u_int8_t *salt,
+    size_t saltlen, u_int32_t count, unsigned int rounds, u_int8_t *out)
+{
+	SHA512_STATE ctx;
+	u_int8_t sha2salt[BCRYPT_PBKDF_SHA512LEN];
+	u_int8_t tmpout[BCRYPT_HASHSIZE];
+	u_int8_t countsalt[4];
+	unsigned int i;
+	size_t j;
+
+	countsalt[0] = (count >> 24) & 0xff;
+	countsalt[1] = (count >> 16) & 0xff;
+	countsalt[2] = (count >> 8) & 0xff;
+	countsalt[3] = count & 0xff;
+
+	/* first round, salt is salt */
+	sha512_init(&ctx);
+	sha512_update(&ctx, salt, saltlen);
+	sha512_update(&ctx, countsalt, sizeof(countsalt));
+	sha512_final(sha2salt, &ctx);
+	bcrypt_hash(sha2pass, sha2salt, tmpout);
+	memcpy(out, tmpout, BCRYPT_HASHSIZE);
+
+	for (i = 1; i < rounds; i++) {
+		/* subsequent rounds, salt is previous output */
+		sha512_init(&ctx);
+		sha512_update(&ctx, tmpout, sizeof(tmpout));
+		sha512_final(sha2salt, &ctx);
+		bcrypt_hash(sha2pass, sha2salt, tmpout);
+		for (j = 0; j < BCRYPT_HASHSIZE; j++)
+			out[j] ^= tmpout[j];
+	}
+
+	memset(sha2salt, 0, sizeof(sha2salt));
+	memset(tmpout, 0, sizeof(tmpout));
+}
+
+void
+bcrypt_pbkdf_scatter(const u_int8_t *out, u_int32_t count, u_int8_t *key,
+    size_t keylen)
+{
+	size_t i, stride, amt, dest;
+
+	/*
+	 * pbkdf2 deviation: output the key material non-linearly.
+	 */
+	stride = bcrypt_pbkdf_blocks(keylen);
+	amt = (keylen + stride - 1) / stride;
+	for (i = 0; i < amt; i++) {
+		dest = i * stride + (count - 1);
+		if (dest >= keylen)
+			break;
+		key[dest] = out[i];
+	}
+}
+
+int
+bcrypt_pbkdf(const char *pass, size_t passlen, const u_int8_t *salt,
+    size_t saltlen, u_int8_t *key, size_t keylen, unsigned int rounds)
+{
+	u_int8_t sha2pass[BCRYPT_PBKDF_SHA512LEN];
+	u_int8_t out[BCRYPT_HASHSIZE];
+	size_t blocks;
+	u_int32_t count;
+
+	if (bcrypt_pbkdf_check(passlen, saltlen, keylen, rounds) != 0)
+		return -1;
+
+	bcrypt_pbkdf_prehash(pass, passlen, sha2pass);
+
+	/* generate key, sizeof(out) at a time */
+	blocks = bcrypt_pbkdf_blocks(keylen);
+	for (count = 1; count <= blocks; count++) {
+		bcrypt_pbkdf_block(sha2pass, salt, saltlen, count, rounds, out);
+		bcrypt_pbkdf_scatter(out, count, key, keylen);
+	}
+
+	/* zap */
+	memset(sha2pass, 0, sizeof(sha2pass));
+	memset(out, 0, sizeof(out));
+
+	return 0;
+}
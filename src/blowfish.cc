@@ -39,6 +39,8 @@
  * Bruce Schneier.
  */
 
+#include <string.h>
+
 #include "node_blf.h"
 
 #undef inline
@@ -57,8 +59,20 @@
 
 #define BLFRND(s,p,i,j,n) (i ^= F(s,j) ^ (p)[n])
 
-void
-Blowfish_encipher(blf_ctx *c, u_int32_t *xl, u_int32_t *xr)
+/* The key schedule below calls the cipher a few thousand times per
+ * expansion; keep it inlined so each multiversioned clone of the
+ * expand functions carries a copy built for its own target.
+ */
+#if defined(__GNUC__)
+#define BLF_ALWAYS_INLINE static inline __attribute__((always_inline))
+#elif defined(_MSC_VER)
+#define BLF_ALWAYS_INLINE static __forceinline
+#else
+#define BLF_ALWAYS_INLINE static inline
+#endif
+
+BLF_ALWAYS_INLINE void
+blf_encipher(blf_ctx *c, u_int32_t *xl, u_int32_t *xr)
 {
 	u_int32_t Xl;
 	u_int32_t Xr;
@@ -82,6 +96,12 @@ Blowfish_encipher(blf_ctx *c, u_int32_t *xl, u_int32_t *xr)
 	*xr = Xl;
 }
 
+BLF_MULTIVERSION void
+Blowfish_encipher(blf_ctx *c, u_int32_t *xl, u_int32_t *xr)
+{
+	blf_encipher(c, xl, xr);
+}
+
 void
 Blowfish_decipher(blf_ctx *c, u_int32_t *xl, u_int32_t *xr)
 {
@@ -407,7 +427,7 @@ Blowfish_stream2word(const u_int8_t *data, u_int16_t databytes,
 	return temp;
 }
 
-void
+BLF_MULTIVERSION void
 Blowfish_expand0state(blf_ctx *c, const u_int8_t *key, u_int16_t keybytes)
 {
 	u_int16_t i;
@@ -428,7 +448,7 @@ Blowfish_expand0state(blf_ctx *c, const u_int8_t *key, u_int16_t keybytes)
 	datal = 0x00000000;
 	datar = 0x00000000;
 	for (i = 0; i < BLF_N + 2; i += 2) {
-		Blowfish_encipher(c, &datal, &datar);
+		blf_encipher(c, &datal, &datar);
 
 		c->P[i] = datal;
 		c->P[i + 1] = datar;
@@ -436,7 +456,7 @@ Blowfish_expand0state(blf_ctx *c, const u_int8_t *key, u_int16_t keybytes)
 
 	for (i = 0; i < 4; i++) {
 		for (k = 0; k < 256; k += 2) {
-			Blowfish_encipher(c, &datal, &datar);
+			blf_encipher(c, &datal, &datar);
 
 			c->S[i][k] = datal;
 			c->S[i][k + 1] = datar;
@@ -445,7 +465,7 @@ Blowfish_expand0state(blf_ctx *c, const u_int8_t *key, u_int16_t keybytes)
 }
 
 
-void
+BLF_MULTIVERSION void
 Blowfish_expandstate(blf_ctx *c, const u_int8_t *data, u_int16_t databytes,
     const u_int8_t *key, u_int16_t keybytes)
 {
@@ -469,7 +489,7 @@ Blowfish_expandstate(blf_ctx *c, const u_int8_t *data, u_int16_t databytes,
 	for (i = 0; i < BLF_N + 2; i += 2) {
 		datal ^= Blowfish_stream2word(data, databytes, &j);
 		datar ^= Blowfish_stream2word(data, databytes, &j);
-		Blowfish_encipher(c, &datal, &datar);
+		blf_encipher(c, &datal, &datar);
 
 		c->P[i] = datal;
 		c->P[i + 1] = datar;
@@ -479,7 +499,7 @@ Blowfish_expandstate(blf_ctx *c, const u_int8_t *data, u_int16_t databytes,
 		for (k = 0; k < 256; k += 2) {
 			datal ^= Blowfish_stream2word(data, databytes, &j);
 			datar ^= Blowfish_stream2word(data, databytes, &j);
-			Blowfish_encipher(c, &datal, &datar);
+			blf_encipher(c, &datal, &datar);
 
 			c->S[i][k] = datal;
 			c->S[i][k + 1] = datar;
@@ -524,46 +544,234 @@ blf_dec(blf_ctx *c, u_int32_t *data, u_int16_t blocks)
 	}
 }
 
-void
+/* Bulk modes.
+ * A single Blowfish block is a serial chain of dependent S-box lookups, so
+ * independent blocks are processed BLF_LANES at a time with their rounds
+ * interleaved, which lets the lookups of different blocks overlap.
+ */
+
+#define BLF_LOAD(d) ((u_int32_t)(d)[0] << 24 | (u_int32_t)(d)[1] << 16 | \
+		     (u_int32_t)(d)[2] << 8 | (u_int32_t)(d)[3])
+
+#define BLF_STORE(d, v) do {		\
+	(d)[0] = (v) >> 24 & 0xff;	\
+	(d)[1] = (v) >> 16 & 0xff;	\
+	(d)[2] = (v) >> 8 & 0xff;	\
+	(d)[3] = (v) & 0xff;		\
+} while (0)
+
+BLF_ALWAYS_INLINE void
+blf_encipher_lanes(blf_ctx *c, u_int32_t *xl, u_int32_t *xr)
+{
+	u_int32_t *s = c->S[0];
+	u_int32_t *p = c->P;
+	u_int32_t l[BLF_LANES], r[BLF_LANES];
+	int i, n;
+
+	for (i = 0; i < BLF_LANES; i++) {
+		l[i] = xl[i] ^ p[0];
+		r[i] = xr[i];
+	}
+	for (n = 1; n <= BLF_N; n += 2) {
+		for (i = 0; i < BLF_LANES; i++)
+			BLFRND(s, p, r[i], l[i], n);
+		for (i = 0; i < BLF_LANES; i++)
+			BLFRND(s, p, l[i], r[i], n + 1);
+	}
+	for (i = 0; i < BLF_LANES; i++) {
+		xl[i] = r[i] ^ p[BLF_N + 1];
+		xr[i] = l[i];
+	}
+}
+
+BLF_ALWAYS_INLINE void
+blf_decipher_lanes(blf_ctx *c, u_int32_t *xl, u_int32_t *xr)
+{
+	u_int32_t *s = c->S[0];
+	u_int32_t *p = c->P;
+	u_int32_t l[BLF_LANES], r[BLF_LANES];
+	int i, n;
+
+	for (i = 0; i < BLF_LANES; i++) {
+		l[i] = xl[i] ^ p[BLF_N + 1];
+		r[i] = xr[i];
+	}
+	for (n = BLF_N; n >= 1; n -= 2) {
+		for (i = 0; i < BLF_LANES; i++)
+			BLFRND(s, p, r[i], l[i], n);
+		for (i = 0; i < BLF_LANES; i++)
+			BLFRND(s, p, l[i], r[i], n - 1);
+	}
+	for (i = 0; i < BLF_LANES; i++) {
+		xl[i] = r[i] ^ p[0];
+		xr[i] = l[i];
+	}
+}
+
+/* Key schedule for BLF_LANES independent states at once, e.g. several
+ * candidate keys under one salt. Each state's cipher chain depends only
+ * on its own S-boxes, so the lanes interleave the same way blocks do.
+ */
+
+BLF_ALWAYS_INLINE void
+blf_encipher_states(blf_ctx *c, u_int32_t *xl, u_int32_t *xr)
+{
+	u_int32_t *s[BLF_LANES], *p[BLF_LANES];
+	u_int32_t l[BLF_LANES], r[BLF_LANES];
+	int i, n;
+
+	for (i = 0; i < BLF_LANES; i++) {
+		s[i] = c[i].S[0];
+		p[i] = c[i].P;
+		l[i] = xl[i] ^ p[i][0];
+		r[i] = xr[i];
+	}
+	for (n = 1; n <= BLF_N; n += 2) {
+		for (i = 0; i < BLF_LANES; i++)
+			BLFRND(s[i], p[i], r[i], l[i], n);
+		for (i = 0; i < BLF_LANES; i++)
+			BLFRND(s[i], p[i], l[i], r[i], n + 1);
+	}
+	for (i = 0; i < BLF_LANES; i++) {
+		xl[i] = r[i] ^ p[i][BLF_N + 1];
+		xr[i] = l[i];
+	}
+}
+
+/* Fills the P-array and S-boxes of each state from its running cipher
+ * output, after the key has been mixed into P. */
+BLF_ALWAYS_INLINE void
+blf_fill_states(blf_ctx *c, const u_int8_t *data, u_int16_t databytes)
+{
+	u_int32_t datal[BLF_LANES], datar[BLF_LANES];
+	u_int32_t dl, dr;
+	u_int16_t i, j, k;
+	int n;
+
+	j = 0;
+	for (n = 0; n < BLF_LANES; n++)
+		datal[n] = datar[n] = 0;
+	for (i = 0; i < BLF_N + 2; i += 2) {
+		if (data) {
+			dl = Blowfish_stream2word(data, databytes, &j);
+			dr = Blowfish_stream2word(data, databytes, &j);
+			for (n = 0; n < BLF_LANES; n++) {
+				datal[n] ^= dl;
+				datar[n] ^= dr;
+			}
+		}
+		blf_encipher_states(c, datal, datar);
+		for (n = 0; n < BLF_LANES; n++) {
+			c[n].P[i] = datal[n];
+			c[n].P[i + 1] = datar[n];
+		}
+	}
+	for (i = 0; i < 4; i++) {
+		for (k = 0; k < 256; k += 2) {
+			if (data) {
+				dl = Blowfish_stream2word(data, databytes, &j);
+				dr = Blowfish_stream2word(data, databytes, &j);
+				for (n = 0; n < BLF_LANES; n++) {
+					datal[n] ^= dl;
+					datar[n] ^= dr;
+				}
+			}
+			blf_encipher_states(c, datal, datar);
+			for (n = 0; n < BLF_LANES; n++) {
+				c[n].S[i][k] = datal[n];
+				c[n].S[i][k + 1] = datar[n];
+			}
+		}
+	}
+}
+
+/* Blowfish_expand0state on each of BLF_LANES states with its own key. */
+BLF_MULTIVERSION void
+Blowfish_expand0state_lanes(blf_ctx *c, const u_int8_t *const *key,
+    const u_int16_t *keybytes)
+{
+	u_int16_t i, j;
+	int n;
+
+	for (n = 0; n < BLF_LANES; n++) {
+		j = 0;
+		for (i = 0; i < BLF_N + 2; i++)
+			c[n].P[i] ^= Blowfish_stream2word(key[n], keybytes[n], &j);
+	}
+	blf_fill_states(c, NULL, 0);
+}
+
+/* Blowfish_expandstate on each of BLF_LANES states with its own key and a
+ * shared salt. */
+BLF_MULTIVERSION void
+Blowfish_expandstate_lanes(blf_ctx *c, const u_int8_t *data,
+    u_int16_t databytes, const u_int8_t *const *key, const u_int16_t *keybytes)
+{
+	u_int16_t i, j;
+	int n;
+
+	for (n = 0; n < BLF_LANES; n++) {
+		j = 0;
+		for (i = 0; i < BLF_N + 2; i++)
+			c[n].P[i] ^= Blowfish_stream2word(key[n], keybytes[n], &j);
+	}
+	blf_fill_states(c, data, databytes);
+}
+
+BLF_MULTIVERSION void
 blf_ecb_encrypt(blf_ctx *c, u_int8_t *data, u_int32_t len)
 {
-	u_int32_t l, r;
+	u_int32_t l[BLF_LANES], r[BLF_LANES];
 	u_int32_t i;
+	int k;
 
-	for (i = 0; i < len; i += 8) {
-		l = data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
-		r = data[4] << 24 | data[5] << 16 | data[6] << 8 | data[7];
-		Blowfish_encipher(c, &l, &r);
-		data[0] = l >> 24 & 0xff;
-		data[1] = l >> 16 & 0xff;
-		data[2] = l >> 8 & 0xff;
-		data[3] = l & 0xff;
-		data[4] = r >> 24 & 0xff;
-		data[5] = r >> 16 & 0xff;
-		data[6] = r >> 8 & 0xff;
-		data[7] = r & 0xff;
+	for (i = 0; i + 8 * BLF_LANES <= len; i += 8 * BLF_LANES) {
+		for (k = 0; k < BLF_LANES; k++) {
+			l[k] = BLF_LOAD(data + 8 * k);
+			r[k] = BLF_LOAD(data + 8 * k + 4);
+		}
+		blf_encipher_lanes(c, l, r);
+		for (k = 0; k < BLF_LANES; k++) {
+			BLF_STORE(data + 8 * k, l[k]);
+			BLF_STORE(data + 8 * k + 4, r[k]);
+		}
+		data += 8 * BLF_LANES;
+	}
+	for (; i < len; i += 8) {
+		l[0] = BLF_LOAD(data);
+		r[0] = BLF_LOAD(data + 4);
+		blf_encipher(c, &l[0], &r[0]);
+		BLF_STORE(data, l[0]);
+		BLF_STORE(data + 4, r[0]);
 		data += 8;
 	}
 }
 
-void
+BLF_MULTIVERSION void
 blf_ecb_decrypt(blf_ctx *c, u_int8_t *data, u_int32_t len)
 {
-	u_int32_t l, r;
+	u_int32_t l[BLF_LANES], r[BLF_LANES];
 	u_int32_t i;
+	int k;
 
-	for (i = 0; i < len; i += 8) {
-		l = data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
-		r = data[4] << 24 | data[5] << 16 | data[6] << 8 | data[7];
-		Blowfish_decipher(c, &l, &r);
-		data[0] = l >> 24 & 0xff;
-		data[1] = l >> 16 & 0xff;
-		data[2] = l >> 8 & 0xff;
-		data[3] = l & 0xff;
-		data[4] = r >> 24 & 0xff;
-		data[5] = r >> 16 & 0xff;
-		data[6] = r >> 8 & 0xff;
-		data[7] = r & 0xff;
+	for (i = 0; i + 8 * BLF_LANES <= len; i += 8 * BLF_LANES) {
+		for (k = 0; k < BLF_LANES; k++) {
+			l[k] = BLF_LOAD(data + 8 * k);
+			r[k] = BLF_LOAD(data + 8 * k + 4);
+		}
+		blf_decipher_lanes(c, l, r);
+		for (k = 0; k < BLF_LANES; k++) {
+			BLF_STORE(data + 8 * k, l[k]);
+			BLF_STORE(data + 8 * k + 4, r[k]);
+		}
+		data += 8 * BLF_LANES;
+	}
+	for (; i < len; i += 8) {
+		l[0] = BLF_LOAD(data);
+		r[0] = BLF_LOAD(data + 4);
+		Blowfish_decipher(c, &l[0], &r[0]);
+		BLF_STORE(data, l[0]);
+		BLF_STORE(data + 4, r[0]);
 		data += 8;
 	}
 }
@@ -634,6 +842,39 @@ blf_cbc_decrypt(blf_ctx *c, u_int8_t *iva, u_int8_t *data, u_int32_t len)
 		data[j] ^= iva[j];
 }
 
+/* Counter mode: the keystream is the encryption of iv, iv + 1, ... taken
+ * as a 64-bit big-endian counter. Encryption and decryption are the same
+ * operation and len need not be a multiple of the block size. iv is not
+ * updated.
+ */
+BLF_MULTIVERSION void
+blf_ctr_crypt(blf_ctx *c, const u_int8_t *iv, u_int8_t *data, u_int32_t len)
+{
+	u_int32_t l[BLF_LANES], r[BLF_LANES];
+	u_int64_t ctr;
+	u_int8_t ks[8 * BLF_LANES];
+	u_int32_t i, n;
+	int k;
+
+	ctr = (u_int64_t)BLF_LOAD(iv) << 32 | BLF_LOAD(iv + 4);
+	for (i = 0; i < len; i += n) {
+		for (k = 0; k < BLF_LANES; k++, ctr++) {
+			l[k] = (u_int32_t)(ctr >> 32);
+			r[k] = (u_int32_t)ctr;
+		}
+		blf_encipher_lanes(c, l, r);
+		for (k = 0; k < BLF_LANES; k++) {
+			BLF_STORE(ks + 8 * k, l[k]);
+			BLF_STORE(ks + 8 * k + 4, r[k]);
+		}
+		n = len - i < sizeof(ks) ? len - i : sizeof(ks);
+		for (k = 0; k < (int)n; k++)
+			data[k] ^= ks[k];
+		data += n;
+	}
+	memset(ks, 0, sizeof(ks));
+}
+
 #if 0
 void
 report(u_int32_t data[], u_int16_t len)
@@ -70,6 +70,21 @@ typedef unsigned int u_int32_t;
 typedef unsigned long long u_int64_t;
 #endif
 
+/* Function multiversioning for the hot path.
+ * Only enabled by the optimized build profile (see binding.gyp). It needs
+ * GCC >= 12 for the x86-64 microarchitecture levels and glibc for the
+ * ifunc resolver that picks a clone at load time; everywhere else the
+ * functions are built once for the baseline target.
+ */
+#if defined(BCRYPT_MULTIVERSION) && defined(__x86_64__) && \
+    defined(__GLIBC__) && !defined(__clang__) && \
+    defined(__GNUC__) && __GNUC__ >= 12
+#define BLF_MULTIVERSION __attribute__((target_clones( \
+	"default", "arch=x86-64-v2", "arch=x86-64-v3", "arch=x86-64-v4")))
+#else
+#define BLF_MULTIVERSION
+#endif
+
 #define BCRYPT_VERSION '2'
 #define BCRYPT_MAXSALT 16	/* Precomputation is just so nice */
 #define BCRYPT_BLOCKS 6		/* Ciphertext blocks */
@@ -83,6 +98,7 @@ typedef unsigned long long u_int64_t;
  */
 
 #define BLF_N	16			/* Number of Subkeys */
+#define BLF_LANES 4			/* Interleaved blocks or states */
 #define BLF_MAXKEYLEN ((BLF_N-2)*4)	/* 448 bits */
 #define BLF_MAXUTILIZED ((BLF_N+2)*4)	/* 576 bits */
 
@@ -107,6 +123,10 @@ void Blowfish_initstate(blf_ctx *);
 void Blowfish_expand0state(blf_ctx *, const u_int8_t *, u_int16_t);
 void Blowfish_expandstate
 (blf_ctx *, const u_int8_t *, u_int16_t, const u_int8_t *, u_int16_t);
+void Blowfish_expand0state_lanes(blf_ctx *, const u_int8_t *const *,
+    const u_int16_t *);
+void Blowfish_expandstate_lanes(blf_ctx *, const u_int8_t *, u_int16_t,
+    const u_int8_t *const *, const u_int16_t *);
 
 /* Standard Blowfish */
 
@@ -120,6 +140,8 @@ void blf_ecb_decrypt(blf_ctx *, u_int8_t *, u_int32_t);
 void blf_cbc_encrypt(blf_ctx *, u_int8_t *, u_int8_t *, u_int32_t);
 void blf_cbc_decrypt(blf_ctx *, u_int8_t *, u_int8_t *, u_int32_t);
 
+void blf_ctr_crypt(blf_ctx *, const u_int8_t *, u_int8_t *, u_int32_t);
+
 /* Converts u_int8_t to u_int32_t */
 u_int32_t Blowfish_stream2word(const u_int8_t *, u_int16_t , u_int16_t *);
 
@@ -129,4 +151,37 @@ void bcrypt(const char *, size_t key_len, const char *, char *);
 void encode_salt(char *, u_int8_t *, char, u_int16_t, u_int8_t);
 u_int32_t bcrypt_get_rounds(const char *);
 
+/* bcrypt on raw salts and digests */
+#define BCRYPT_DIGEST_LEN (4 * BCRYPT_BLOCKS - 1)	/* 23 bytes */
+#define BCRYPT_BINARY_LEN (2 + BCRYPT_MAXSALT + BCRYPT_DIGEST_LEN)	/* 41 */
+#define BCRYPT_SALT_ENCODED_LEN 22
+#define BCRYPT_ENCODED_LEN (BCRYPT_SALT_ENCODED_LEN + 31)
+
+int bcrypt_parse_salt(const char *, u_int8_t *, u_int8_t *, u_int8_t *);
+void bcrypt_raw(const char *, size_t, u_int8_t, u_int8_t, const u_int8_t *,
+    u_int8_t *);
+int bcrypt_binary(const char *, size_t, const char *, u_int8_t *);
+int bcrypt_binary_compare(const char *, size_t, const u_int8_t *);
+int bcrypt_check_hash(const char *, u_int8_t *, u_int8_t *);
+int bcrypt_to_binary(const char *, u_int8_t *);
+int bcrypt_from_binary(const u_int8_t *, char *);
+int bcrypt_compare_any(const char *const *, const size_t *, size_t,
+    const u_int8_t *);
+
+/* bcrypt_pbkdf functions */
+#define BCRYPT_PBKDF_SHA512LEN 64	/* SHA-512 digest of pass and salt */
+#define BCRYPT_PBKDF_BLOCKLEN 32	/* output bytes per block */
+#define BCRYPT_PBKDF_MAXKEYLEN (BCRYPT_PBKDF_BLOCKLEN * BCRYPT_PBKDF_BLOCKLEN)
+
+int bcrypt_pbkdf(const char *, size_t, const u_int8_t *, size_t,
+    u_int8_t *, size_t, unsigned int);
+int bcrypt_pbkdf_check(size_t, size_t, size_t, unsigned int);
+size_t bcrypt_pbkdf_blocks(size_t);
+void bcrypt_pbkdf_prehash(const char *, size_t, u_int8_t *);
+void bcrypt_pbkdf_block(const u_int8_t *, const u_int8_t *, size_t,
+    u_int32_t, unsigned int, u_int8_t *);
+void bcrypt_pbkdf_scatter(const u_int8_t *, u_int32_t, u_int8_t *, size_t);
+void bcrypt_sha512_vec(const u_int8_t *const *, const size_t *, size_t,
+    u_int8_t *);
+
 #endif
@@ -0,0 +1,73 @@
+const bcrypt = require('../bcrypt');
+
+const hash = '$2b$04$......................CZJXs39HZ6odvxM3EvHl/Fh/PsT/WM6';
+
+test('compare_any_sync', () => {
+    expect(bcrypt.compareAnySync(['pw'], hash)).toBe(0);
+    expect(bcrypt.compareAnySync([' pw ', 'pw'], hash)).toBe(1);
+    expect(bcrypt.compareAnySync(['a', 'b', 'c', 'd', 'pw', 'pw'], hash)).toBe(4);
+    expect(bcrypt.compareAnySync(['a', 'b', 'c', 'd', 'e'], hash)).toBe(-1);
+    expect(bcrypt.compareAnySync(['a', Buffer.from('pw')], hash)).toBe(1);
+})
+
+test('compare_any_every_position', () => {
+    for (let count = 1; count <= 9; count++) {
+        for (let position = 0; position < count; position++) {
+            const candidates = Array.from({ length: count }, (_, i) => (i === position ? 'pw' : 'x'.repeat(i * 20)));
+            expect(bcrypt.compareAnySync(candidates, hash)).toBe(position);
+        }
+    }
+})
+
+test('compare_any_binary', () => {
+    const binary = bcrypt.toBinary(hash);
+    expect(bcrypt.compareAnySync(['a', 'b', 'pw'], binary)).toBe(2);
+    expect(bcrypt.compareAnySync(['a'], Buffer.alloc(41))).toBe(-1);
+})
+
+test('compare_any_matches_compare', () => {
+    const long = 'x'.repeat(100);
+    for (const salt of [bcrypt.genSaltSync(4, 'a'), bcrypt.genSaltSync(4, 'b')]) {
+        const encrypted = bcrypt.hashSync(long, salt);
+        const candidates = ['a', 'x'.repeat(72), long, 'b'];
+        const expected = candidates.findIndex(candidate => bcrypt.compareSync(candidate, encrypted));
+        expect(bcrypt.compareAnySync(candidates, encrypted)).toBe(expected);
+    }
+})
+
+test('compare_any_invalid', () => {
+    expect(bcrypt.compareAnySync(['pw'], 'not a hash')).toBe(-1);
+    expect(() => bcrypt.compareAnySync([], hash)).toThrowError('candidates must be an array of 1 to 16 strings or Buffers');
+    expect(() => bcrypt.compareAnySync(new Array(17).fill('pw'), hash)).toThrowError('candidates must be an array of 1 to 16 strings or Buffers');
+    expect(() => bcrypt.compareAnySync([1], hash)).toThrowError('candidates must be an array of 1 to 16 strings or Buffers');
+    expect(() => bcrypt.compareAnySync('pw', hash)).toThrowError('candidates must be an array of 1 to 16 strings or Buffers');
+    expect(() => bcrypt.compareAnySync(['pw'], 1)).toThrowError('hash must be a string or Buffer');
+    expect(() => bcrypt.compareAnySync(['pw'], Buffer.alloc(40))).toThrowError('hash must be a 41 byte Buffer');
+})
+
+test('compare_any', done => {
+    bcrypt.compareAny(['a', 'b', 'pw'], hash, function (err, index, cpuTime) {
+        expect(err).toBeUndefined();
+        expect(index).toBe(2);
+        expect(typeof cpuTime).toBe('number');
+        done();
+    });
+})
+
+test('compare_any_promise', async () => {
+    expect(await bcrypt.compareAny(['pw', 'a'], hash)).toBe(0);
+    expect(await bcrypt.compareAny(['a', 'b'], hash)).toBe(-1);
+    await expect(bcrypt.compareAny([], hash)).rejects.toThrow('candidates must be an array of 1 to 16 strings or Buffers');
+})
+
+test('compare_any_non_canonical', () => {
+    // unused low bits set in the last character: compareSync says no, and
+    // compareAny must not accept the hash through its binary decoding
+    const nonCanonical = hash.slice(0, -1) + '7';
+    expect(bcrypt.compareSync('pw', nonCanonical)).toBe(false);
+    expect(bcrypt.compareAnySync(['pw'], nonCanonical)).toBe(-1);
+    expect(bcrypt.compareAnySync(['a', 'b', 'c', 'pw'], nonCanonical)).toBe(-1);
+    return bcrypt.compareAny(['a', 'pw'], nonCanonical).then(index => {
+        expect(index).toBe(-1);
+    });
+})
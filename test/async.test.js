@@ -207,3 +207,19 @@ test('hash_compare_one_param', done => {
         done();
     });
 })
+
+test('hash_long_passwords', done => {
+    expect.assertions(3);
+    // keys past 72 bytes only change $2a$ hashes through their length
+    const long = '01XXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXXX';
+    bcrypt.hash(long, '$2a$05$CCCCCCCCCCCCCCCCCCCCC.', function (err, hash) {
+        expect(hash).toStrictEqual('$2a$05$CCCCCCCCCCCCCCCCCCCCC.6.O1dLNbjod2uo0DVcW.jHucKbPDdHS');
+        bcrypt.compare(Buffer.from(long), hash, function (err, res) {
+            expect(res).toBe(true);
+            bcrypt.compare('x'.repeat(80), '$2b$05$CCCCCCCCCCCCCCCCCCCCC.' + 'x'.repeat(200), function (err, res) {
+                expect(res).toBe(false);
+                done();
+            });
+        });
+    });
+})
@@ -0,0 +1,94 @@
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+const bcrypt = require('../bcrypt');
+
+const good4 = '$2b$04$......................CZJXs39HZ6odvxM3EvHl/Fh/PsT/WM6';
+const good5 = '$2a$05$CCCCCCCCCCCCCCCCCCCCC.E5YPO9kmyuRGyh0XouQYb4YMJKvyOeW';
+const legacy = '$2$05$CCCCCCCCCCCCCCCCCCCCC.jF6e30Q.MJu7YLpuFMA1H4zRvXqeP7a';
+
+let dir;
+
+beforeAll(() => {
+    dir = fs.mkdtempSync(path.join(os.tmpdir(), 'bcrypt-audit-'));
+})
+
+afterAll(() => {
+    fs.rmSync(dir, { recursive: true, force: true });
+})
+
+function write(name, lines) {
+    const file = path.join(dir, name);
+    fs.writeFileSync(file, lines.join('\n'));
+    return file;
+}
+
+test('audit_sync_lines', () => {
+    const file = write('lines.txt', [good4, good5, '', 'not a hash', legacy, good5.slice(0, -1)]);
+    const report = bcrypt.auditSync(file, { minCost: 5 });
+    expect(report.total).toBe(5);
+    expect(report.valid).toBe(3);
+    expect(report.invalid).toBe(2);
+    expect(report.versions).toStrictEqual({ '2': 1, '2a': 1, '2b': 1 });
+    expect(report.costs).toStrictEqual({ '4': 1, '5': 2 });
+    expect(report.belowPolicy).toBe(1);
+    expect(report.belowPolicyOffsets).toStrictEqual([0]);
+    expect(report.invalidOffsets).toStrictEqual([123, 194]);
+    expect(report.truncated).toBe(false);
+})
+
+test('audit_sync_csv', () => {
+    const file = write('users.csv', [
+        'id,email,hash',
+        `1,"a, b@example.com",${good4}\r`,
+        `2,c@example.com,"${good5}"`,
+        '3,d@example.com,',
+    ]);
+    const report = bcrypt.auditSync(file, { column: 2, header: true, maxOffsets: 0 });
+    expect(report.total).toBe(3);
+    expect(report.valid).toBe(2);
+    expect(report.invalid).toBe(1);
+    expect(report.invalidOffsets).toStrictEqual([]);
+    expect(report.truncated).toBe(true);
+})
+
+test('audit_async', () => {
+    const lines = [];
+    for (let i = 0; i < 1000; i++) {
+        lines.push(i % 10 ? good5 : good4);
+    }
+    const file = write('many.txt', lines);
+    return bcrypt.audit(file, { minCost: 5, threads: 4 }).then(report => {
+        expect(report.valid).toBe(1000);
+        expect(report.belowPolicy).toBe(100);
+        expect(report.belowPolicyOffsets[1]).toBe(10 * (good5.length + 1));
+    });
+})
+
+test('audit_errors', () => {
+    expect(() => bcrypt.auditSync(path.join(dir, 'missing'))).toThrowError('could not open');
+    expect(() => bcrypt.auditSync(42)).toThrowError('path must be a string');
+    expect(() => bcrypt.auditSync('x', { minCost: 32 })).toThrowError('minCost must be an integer between 0 and 31');
+    return expect(bcrypt.audit(path.join(dir, 'missing'))).rejects.toThrow('could not open');
+})
+
+test('audit_threads_match_single', () => {
+    // Large enough for four chunks of at least a megabyte each, with lines
+    // of varying length so the split points fall inside records.
+    const lines = ['id,hash'];
+    for (let i = 0; i < 80000; i++) {
+        const hash = i % 7 === 0 ? good4 : i % 11 === 0 ? 'x'.repeat(i % 50) : i % 13 === 0 ? legacy : good5;
+        lines.push(`${i},"${'y'.repeat(i % 17)}",${hash}`);
+    }
+    const file = write('large.csv', lines);
+    expect(fs.statSync(file).size).toBeGreaterThan(4 << 20);
+
+    const options = { column: 2, header: true, minCost: 5, maxOffsets: 1e6 };
+    const single = bcrypt.auditSync(file, { ...options, threads: 1 });
+    expect(single.total).toBe(80000);
+    expect(single.invalid).toBeGreaterThan(0);
+    expect(bcrypt.auditSync(file, { ...options, threads: 4 })).toStrictEqual(single);
+    return bcrypt.audit(file, { ...options, threads: 4 }).then(report => {
+        expect(report).toStrictEqual(single);
+    });
+})
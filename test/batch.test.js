@@ -0,0 +1,125 @@
+const path = require('path');
+const { spawnSync } = require('child_process');
+const { AsyncLocalStorage } = require('async_hooks');
+const bcrypt = require('../bcrypt');
+
+afterEach(() => {
+    bcrypt.batchCompletions(false);
+})
+
+test('batched_results_match', () => {
+    bcrypt.batchCompletions(true);
+    const before = bcrypt.completionStats();
+    expect(before.enabled).toBe(true);
+
+    const salt = bcrypt.genSaltSync(4);
+    const hash = bcrypt.hashSync('password', salt);
+    const jobs = [];
+    for (let i = 0; i < 32; i++) {
+        jobs.push(bcrypt.compare(i % 2 ? 'password' : 'wrong', hash));
+    }
+    jobs.push(bcrypt.hash('password', salt));
+    expect(bcrypt.completionStats().outstanding).toBe(33);
+
+    return Promise.all(jobs).then(results => {
+        for (let i = 0; i < 32; i++) {
+            expect(results[i]).toBe(i % 2 === 1);
+        }
+        expect(results[32]).toStrictEqual(hash);
+        const after = bcrypt.completionStats();
+        expect(after.outstanding).toBe(0);
+        expect(after.delivered - before.delivered).toBe(33);
+        expect(after.batches - before.batches).toBeGreaterThan(0);
+        expect(after.batches - before.batches).toBeLessThanOrEqual(33);
+    });
+})
+
+test('batched_errors_and_cpu_time', done => {
+    bcrypt.batchCompletions(true);
+    expect.assertions(3);
+    bcrypt.hash('password', 'invalid salt', function (err) {
+        expect(err.message).toContain('Invalid salt');
+        bcrypt.hash('password', bcrypt.genSaltSync(4), function (err, hash, cpuTime) {
+            expect(err).toBeUndefined();
+            expect(typeof cpuTime).toBe('number');
+            done();
+        });
+    });
+})
+
+test('batched_with_tenant_limit', () => {
+    bcrypt.batchCompletions(true);
+    const tenant = bcrypt.tenant('batched_with_tenant_limit', { maxInFlight: 2 });
+    const hash = bcrypt.hashSync('password', 4);
+    const jobs = [];
+    for (let i = 0; i < 6; i++) {
+        jobs.push(tenant.compare('password', hash));
+    }
+    return Promise.all(jobs).then(results => {
+        expect(results.every(Boolean)).toBe(true);
+        expect(tenant.stats().completed).toBe(6);
+    });
+})
+
+test('batched_keep_their_async_context', () => {
+    const storage = new AsyncLocalStorage();
+    storage.run('enabler', () => bcrypt.batchCompletions(true));
+    const hash = bcrypt.hashSync('password', 4);
+    const jobs = [];
+    for (let i = 0; i < 8; i++) {
+        jobs.push(storage.run(i, () => new Promise(resolve => {
+            const cb = () => resolve(storage.getStore());
+            if (i === 7) {
+                bcrypt.hash('password', 'invalid salt', cb);
+            } else {
+                bcrypt.compare('password', hash, cb);
+            }
+        })));
+    }
+    return Promise.all(jobs).then(stores => {
+        expect(stores).toStrictEqual([0, 1, 2, 3, 4, 5, 6, 7]);
+    });
+})
+
+test('batched_without_async_context', () => {
+    bcrypt.batchCompletions(true, { asyncContext: false });
+    const hash = bcrypt.hashSync('password', 4);
+    const jobs = [];
+    for (let i = 0; i < 8; i++) {
+        jobs.push(bcrypt.compare(i % 2 ? 'password' : 'wrong', hash));
+    }
+    jobs.push(bcrypt.hash('password', 'invalid salt').catch(err => err.message));
+    return Promise.all(jobs).then(results => {
+        expect(results.slice(0, 8)).toStrictEqual([false, true, false, true, false, true, false, true]);
+        expect(results[8]).toContain('Invalid salt');
+        expect(bcrypt.completionStats().outstanding).toBe(0);
+    });
+})
+
+// Runs in a child process, since every callback throws: each exception must
+// reach 'uncaughtException' on its own, batched or not.
+function throwingCallbacks(batched) {
+    const script = `
+        const bcrypt = require(${JSON.stringify(path.resolve(__dirname, '../bcrypt'))});
+        const seen = [];
+        process.on('uncaughtException', err => seen.push(err.message));
+        process.on('exit', () => console.log(JSON.stringify(seen.sort())));
+        bcrypt.batchCompletions(${batched});
+        const hash = bcrypt.hashSync('password', 4);
+        for (let i = 0; i < 4; i++) {
+            bcrypt.compare('password', hash, () => { throw new Error('callback ' + i); });
+        }
+        bcrypt.hash('password', 'invalid salt', () => { throw new Error('callback 4'); });
+    `;
+    return spawnSync(process.execPath, ['-e', script], { encoding: 'utf8' });
+}
+
+test('batched_callback_exceptions_are_uncaught', () => {
+    const unbatched = throwingCallbacks(false);
+    const batched = throwingCallbacks(true);
+    const expected = ['callback 0', 'callback 1', 'callback 2', 'callback 3', 'callback 4'];
+    expect(JSON.parse(unbatched.stdout)).toStrictEqual(expected);
+    expect(JSON.parse(batched.stdout)).toStrictEqual(expected);
+    expect(batched.status).toBe(0);
+    expect(batched.stderr).not.toContain('DEP0168');
+})
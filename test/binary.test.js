@@ -0,0 +1,71 @@
+const bcrypt = require('../bcrypt');
+
+const hashes = [
+    ['U*U', '$2a$05$CCCCCCCCCCCCCCCCCCCCC.E5YPO9kmyuRGyh0XouQYb4YMJKvyOeW'],
+    ['pw', '$2b$04$......................CZJXs39HZ6odvxM3EvHl/Fh/PsT/WM6'],
+    ['pw', '$2$05$CCCCCCCCCCCCCCCCCCCCC.jF6e30Q.MJu7YLpuFMA1H4zRvXqeP7a'],
+];
+
+test('binary_round_trip', () => {
+    for (const [, hash] of hashes) {
+        const binary = bcrypt.toBinary(hash);
+        expect(binary.length).toBe(41);
+        expect(bcrypt.fromBinary(binary)).toStrictEqual(hash);
+    }
+    expect(bcrypt.toBinary(hashes[0][1])[0]).toBe(0x2a);
+    expect(bcrypt.toBinary(hashes[0][1])[1]).toBe(5);
+    expect(bcrypt.toBinary(hashes[1][1])[0]).toBe(0x2b);
+    expect(bcrypt.toBinary(hashes[2][1])[0]).toBe(0x20);
+})
+
+test('binary_invalid', () => {
+    expect(() => bcrypt.toBinary('$2a$05$CCCC')).toThrowError('invalid hash provided');
+    expect(() => bcrypt.toBinary(hashes[0][1] + 'x')).toThrowError('invalid hash provided');
+    expect(() => bcrypt.fromBinary(Buffer.alloc(40))).toThrowError('hash must be a 41 byte Buffer');
+    expect(() => bcrypt.fromBinary(Buffer.alloc(41))).toThrowError('invalid hash provided');
+    expect(() => bcrypt.compareBinarySync('pw', hashes[1][1])).toThrowError('data must be a string or Buffer and hash must be a Buffer');
+    expect(bcrypt.compareBinarySync('pw', Buffer.alloc(41))).toBe(false);
+})
+
+test('compare_binary_sync', () => {
+    for (const [password, hash] of hashes) {
+        const binary = bcrypt.toBinary(hash);
+        expect(bcrypt.compareBinarySync(password, binary)).toBe(true);
+        expect(bcrypt.compareBinarySync(password + 'x', binary)).toBe(false);
+    }
+})
+
+test('hash_binary_sync', () => {
+    const salt = hashes[1][1].slice(0, 29);
+    expect(bcrypt.hashBinarySync('pw', salt).equals(bcrypt.toBinary(hashes[1][1]))).toBe(true);
+    const binary = bcrypt.hashBinarySync('password', 4);
+    expect(binary[1]).toBe(4);
+    expect(bcrypt.compareSync('password', bcrypt.fromBinary(binary))).toBe(true);
+    expect(() => bcrypt.hashBinarySync('password', '$2b$04$bad')).toThrowError('Invalid salt');
+})
+
+test('binary_async', () => {
+    return bcrypt.hashBinary('password', 4).then(binary => {
+        expect(binary.length).toBe(41);
+        return Promise.all([
+            bcrypt.compareBinary('password', binary),
+            bcrypt.compareBinary('wrong', binary),
+        ]);
+    }).then(([good, bad]) => {
+        expect(good).toBe(true);
+        expect(bad).toBe(false);
+    });
+})
+
+test('binary_async_errors', () => {
+    return expect(bcrypt.compareBinary('password', Buffer.alloc(10))).rejects.toThrow('hash must be a 41 byte Buffer');
+})
+
+test('binary_non_canonical', () => {
+    // the last character's unused low bits are set, which bcrypt never
+    // produces, so compare rejects it and the binary form must too
+    const nonCanonical = hashes[1][1].slice(0, -1) + '7';
+    expect(bcrypt.compareSync('pw', nonCanonical)).toBe(false);
+    expect(() => bcrypt.toBinary(nonCanonical)).toThrowError('invalid hash provided');
+    expect(() => bcrypt.toBinary('$2b$04$.....................A' + hashes[1][1].slice(29))).toThrowError('invalid hash provided');
+})
@@ -0,0 +1,65 @@
+const { Blowfish } = require('../bcrypt');
+
+// vectors from Eric Young's Blowfish test set
+
+test('ecb_vectors', () => {
+    const bf = new Blowfish(Buffer.from('3000000000000000', 'hex'));
+    const data = Buffer.from('1000000000000001', 'hex');
+    expect(bf.encryptEcbSync(data).toString('hex')).toStrictEqual('7d856f9a613063f2');
+    expect(bf.decryptEcbSync(data).toString('hex')).toStrictEqual('1000000000000001');
+
+    const ones = new Blowfish(Buffer.alloc(8, 0xff));
+    expect(ones.encryptEcbSync(Buffer.alloc(8, 0xff)).toString('hex')).toStrictEqual('51866fd5b85ecb8a');
+})
+
+test('cbc_vector', () => {
+    const bf = new Blowfish(Buffer.from('0123456789abcdeff0e1d2c3b4a59687', 'hex'));
+    const iv = Buffer.from('fedcba9876543210', 'hex');
+    const data = Buffer.alloc(32);
+    data.write('7654321 Now is the time for ');
+
+    bf.encryptCbcSync(data, iv);
+    expect(data.toString('hex')).toStrictEqual('6b77b4d63006dee605b156e27403979358deb9e7154616d959f1652bd5ff92cc');
+    bf.decryptCbcSync(data, iv);
+    expect(data.toString('latin1', 0, 28)).toStrictEqual('7654321 Now is the time for ');
+})
+
+test('ctr_matches_ecb_keystream', () => {
+    const bf = new Blowfish('abcdefghijklmnopqrstuvwxyz');
+    const iv = Buffer.from('00000000fffffffe', 'hex');
+    const plain = Buffer.from(Array.from({length: 101}, (_, i) => i));
+
+    const keystream = Buffer.alloc(104);
+    for (let i = 0; i < 13; i++) {
+        keystream.writeBigUInt64BE(0xfffffffen + BigInt(i), i * 8);
+    }
+    bf.encryptEcbSync(keystream);
+
+    const data = Buffer.from(plain);
+    bf.ctrSync(data, iv);
+    expect(data.equals(Buffer.from(plain.map((b, i) => b ^ keystream[i])))).toBe(true);
+    bf.ctrSync(data, iv);
+    expect(data.equals(plain)).toBe(true);
+})
+
+test('async_above_threshold', () => {
+    const bf = new Blowfish('key', { asyncThreshold: 1024 });
+    const plain = Buffer.alloc(4096, 7);
+    const expected = bf.encryptEcbSync(Buffer.from(plain));
+
+    return Promise.all([
+        bf.encryptEcb(Buffer.from(plain)),
+        bf.encryptEcb(Buffer.from(plain.subarray(0, 512))),
+    ]).then(([big, small]) => {
+        expect(big.equals(expected)).toBe(true);
+        expect(small.equals(expected.subarray(0, 512))).toBe(true);
+    });
+})
+
+test('invalid_arguments', () => {
+    expect(() => new Blowfish(Buffer.alloc(0))).toThrowError('key must be between 1 and 72 bytes');
+    const bf = new Blowfish('key');
+    expect(() => bf.encryptEcbSync(Buffer.alloc(7))).toThrowError('data length must be a multiple of 8 bytes');
+    expect(() => bf.ctrSync(Buffer.alloc(7), Buffer.alloc(4))).toThrowError('iv must be an 8 byte Buffer');
+    return expect(bf.encryptCbc(Buffer.alloc(16), null)).rejects.toThrow('iv must be an 8 byte Buffer');
+})
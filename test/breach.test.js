@@ -0,0 +1,85 @@
+const crypto = require('crypto');
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+const bcrypt = require('../bcrypt');
+
+const breached = ['password', '123456', 'letmein'];
+let dir;
+let passwordHash;
+
+// writes a filter in the format documented in include/bcrypt.h
+function writeFilter(file, passwords) {
+    const blocks = 4;
+    const hashes = 7;
+    const filter = Buffer.alloc(64 + blocks * 64);
+    filter.write('BCRYPTBF', 0, 'latin1');
+    filter.writeUInt32LE(1, 8);
+    filter.writeUInt32LE(hashes, 12);
+    filter.writeBigUInt64LE(BigInt(blocks), 16);
+    filter.writeBigUInt64LE(BigInt(passwords.length), 24);
+    filter.writeUInt32LE(10, 32);
+    for (const password of passwords) {
+        const digest = crypto.createHash('sha1').update(password).digest();
+        const block = 64 + Number(digest.readBigUInt64BE(0) % BigInt(blocks)) * 64;
+        for (let i = 0; i < hashes; i++) {
+            const offset = 64 + 9 * i;
+            const bit = ((digest[offset >> 3] << 8 | digest[(offset >> 3) + 1]) >> (7 - offset % 8)) & 511;
+            filter[block + (bit >> 3)] |= 1 << (bit & 7);
+        }
+    }
+    fs.writeFileSync(file, filter);
+}
+
+beforeAll(() => {
+    passwordHash = bcrypt.hashSync('password', 4);
+    dir = fs.mkdtempSync(path.join(os.tmpdir(), 'bcrypt-breach-'));
+    writeFilter(path.join(dir, 'breached.bf'), breached);
+    fs.writeFileSync(path.join(dir, 'truncated.bf'), fs.readFileSync(path.join(dir, 'breached.bf')).subarray(0, 100));
+})
+
+afterAll(() => {
+    bcrypt.loadBreachFilter(null);
+    fs.rmSync(dir, { recursive: true, force: true });
+})
+
+test('breach_filter_not_loaded', () => {
+    expect(bcrypt.isBreached('password')).toBe(false);
+    expect(bcrypt.hashSync('password', 4)).toMatch(/^\$2b\$04\$/);
+})
+
+test('breach_filter_load', () => {
+    const info = bcrypt.loadBreachFilter(path.join(dir, 'breached.bf'));
+    expect(info).toStrictEqual({ entries: 3, bitsPerEntry: 10, hashes: 7, size: 320 });
+    for (const password of breached) {
+        expect(bcrypt.isBreached(password)).toBe(true);
+        expect(bcrypt.isBreached(Buffer.from(password))).toBe(true);
+    }
+    expect(bcrypt.isBreached('correct horse battery staple')).toBe(false);
+})
+
+test('breach_filter_rejects_hashing', async () => {
+    bcrypt.loadBreachFilter(path.join(dir, 'breached.bf'));
+    expect(() => bcrypt.hashSync('password', 4)).toThrowError('data appears in the breached password filter');
+    expect(() => bcrypt.hashBinarySync('123456', 4)).toThrowError('data appears in the breached password filter');
+    expect(() => bcrypt.hashIntoSync('letmein', 4, Buffer.alloc(60))).toThrowError('data appears in the breached password filter');
+    await expect(bcrypt.hash('password', 4)).rejects.toMatchObject({ code: 'EBREACHED' });
+    await expect(bcrypt.hashBinary('password', 4)).rejects.toMatchObject({ code: 'EBREACHED' });
+    await expect(bcrypt.hashInto('password', 4, Buffer.alloc(60))).rejects.toMatchObject({ code: 'EBREACHED' });
+    expect(await bcrypt.hash('correct horse battery staple', 4)).toMatch(/^\$2b\$04\$/);
+    // comparing is unaffected, so existing users can still log in
+    expect(bcrypt.compareSync('password', passwordHash)).toBe(true);
+})
+
+test('breach_filter_invalid', () => {
+    expect(() => bcrypt.loadBreachFilter(path.join(dir, 'missing.bf'))).toThrowError(/could not open/);
+    expect(() => bcrypt.loadBreachFilter(path.join(dir, 'truncated.bf'))).toThrowError('is not a breached password filter');
+    expect(() => bcrypt.loadBreachFilter(1)).toThrowError('path must be a string');
+    expect(() => bcrypt.isBreached(1)).toThrowError('data must be a string or Buffer');
+})
+
+test('breach_filter_unload', () => {
+    bcrypt.loadBreachFilter(path.join(dir, 'breached.bf'));
+    bcrypt.loadBreachFilter(null);
+    expect(bcrypt.isBreached('password')).toBe(false);
+})
@@ -0,0 +1,72 @@
+const fs = require('fs');
+const path = require('path');
+const { spawnSync } = require('child_process');
+
+// built next to the addon when installing from source; prebuilt installs
+// only ship the addon
+const cli = path.resolve(__dirname, '../build/Release', process.platform === 'win32' ? 'bcrypt.exe' : 'bcrypt');
+const cliTest = fs.existsSync(cli) ? test : test.skip;
+
+function run(args, input) {
+    return spawnSync(cli, args, { input, encoding: 'utf8' });
+}
+
+cliTest('cli_hash_and_verify', () => {
+    const hashed = run(['hash', '-c', '4', '-t', '2'], 'hunter2\ncorrect horse\r\n\n');
+    expect(hashed.status).toBe(0);
+    const hashes = hashed.stdout.trim().split('\n');
+    expect(hashes.length).toBe(3);
+    hashes.forEach(hash => expect(hash).toMatch(/^\$2b\$04\$[./A-Za-z0-9]{53}$/));
+
+    const verified = run(['verify'], `${hashes[0]} hunter2\n${hashes[1]}\tcorrect horse\n${hashes[2]} \n`);
+    expect(verified.status).toBe(0);
+    expect(verified.stdout).toBe('ok\nok\nok\n');
+})
+
+cliTest('cli_verify_failures', () => {
+    const verified = run(['verify'],
+        '$2a$05$CCCCCCCCCCCCCCCCCCCCC.E5YPO9kmyuRGyh0XouQYb4YMJKvyOeW U*U\n' +
+        '$2a$05$CCCCCCCCCCCCCCCCCCCCC.E5YPO9kmyuRGyh0XouQYb4YMJKvyOeW U*V\n' +
+        'not-a-hash password\n');
+    expect(verified.status).toBe(1);
+    expect(verified.stdout).toBe('ok\nmismatch\ninvalid\n');
+})
+
+cliTest('cli_usage', () => {
+    expect(run(['frobnicate'], '').status).toBe(2);
+    expect(run(['hash', '-c', '3'], '').status).toBe(2);
+})
+
+cliTest('cli_breach_filter', () => {
+    const crypto = require('crypto');
+    const os = require('os');
+    const bcrypt = require('../bcrypt');
+    const dir = fs.mkdtempSync(path.join(os.tmpdir(), 'bcrypt-cli-'));
+    try {
+        const list = path.join(dir, 'list.txt');
+        const output = path.join(dir, 'breached.bf');
+        const sha1 = password => crypto.createHash('sha1').update(password).digest('hex');
+        fs.writeFileSync(list, `${sha1('password').toUpperCase()}:3861493\n${sha1('hunter2')}\r\n\n`);
+        expect(run(['filter', '-b', '12', output, list], '').status).toBe(0);
+        expect(bcrypt.loadBreachFilter(output)).toMatchObject({ entries: 2, bitsPerEntry: 12 });
+        expect(bcrypt.isBreached('password')).toBe(true);
+        expect(bcrypt.isBreached('hunter2')).toBe(true);
+        expect(bcrypt.isBreached('correct horse battery staple')).toBe(false);
+
+        // rebuilding replaces the file; the loaded mapping keeps the old one
+        fs.writeFileSync(list, `${sha1('letmein')}\n`);
+        expect(run(['filter', output, list], '').status).toBe(0);
+        expect(fs.existsSync(output + '.tmp')).toBe(false);
+        expect(bcrypt.isBreached('password')).toBe(true);
+        expect(bcrypt.loadBreachFilter(output)).toMatchObject({ entries: 1, bitsPerEntry: 16 });
+        expect(bcrypt.isBreached('letmein')).toBe(true);
+        expect(bcrypt.isBreached('password')).toBe(false);
+
+        fs.writeFileSync(list, 'not a digest\n');
+        expect(run(['filter', output, list], '').status).toBe(1);
+        expect(run(['filter', output], '').status).toBe(2);
+    } finally {
+        bcrypt.loadBreachFilter(null);
+        fs.rmSync(dir, { recursive: true, force: true });
+    }
+})
@@ -0,0 +1,101 @@
+const path = require('path');
+const { spawnSync } = require('child_process');
+const { AsyncLocalStorage } = require('async_hooks');
+const bcrypt = require('../bcrypt');
+
+afterEach(() => {
+    bcrypt.coalesceCompares(false);
+})
+
+test('identical_compares_share_one_flight', () => {
+    const hash = bcrypt.hashSync('password', 4);
+    bcrypt.coalesceCompares(true);
+    const before = bcrypt.compareCoalescingStats();
+    expect(before.enabled).toBe(true);
+
+    const compares = [];
+    for (let i = 0; i < 5; i++) {
+        compares.push(bcrypt.compare('password', hash));
+    }
+    compares.push(bcrypt.compare('wrong', hash));
+
+    const during = bcrypt.compareCoalescingStats();
+    expect(during.flights - before.flights).toBe(2);
+    expect(during.joined - before.joined).toBe(4);
+    expect(during.inFlight).toBe(2);
+
+    return Promise.all(compares).then(results => {
+        expect(results).toStrictEqual([true, true, true, true, true, false]);
+        expect(bcrypt.compareCoalescingStats().inFlight).toBe(0);
+    });
+})
+
+test('followers_receive_zero_cpu_time', done => {
+    const hash = bcrypt.hashSync('password', 4);
+    bcrypt.coalesceCompares(true);
+    bcrypt.compare('password', hash, function () {});
+    bcrypt.compare('password', hash, function (err, same, cpuTime) {
+        expect(same).toBe(true);
+        expect(cpuTime).toBe(0);
+        done();
+    });
+})
+
+test('disabled_by_default', () => {
+    const hash = bcrypt.hashSync('password', 4);
+    const before = bcrypt.compareCoalescingStats();
+    expect(before.enabled).toBe(false);
+    return Promise.all([bcrypt.compare('password', hash), bcrypt.compare('password', hash)]).then(results => {
+        expect(results).toStrictEqual([true, true]);
+        expect(bcrypt.compareCoalescingStats().joined).toBe(before.joined);
+    });
+})
+
+test('flights_do_not_cross_tenants', () => {
+    const hash = bcrypt.hashSync('password', 4);
+    const busy = bcrypt.tenant('flights_busy', { maxInFlight: 1 });
+    const other = bcrypt.tenant('flights_other');
+    bcrypt.coalesceCompares(true);
+    const before = bcrypt.compareCoalescingStats();
+
+    const compares = [busy.compare('wrong', hash), busy.compare('password', hash), other.compare('password', hash)];
+    expect(busy.stats().pending).toBe(1);
+    expect(other.stats().inFlight).toBe(1);
+    const during = bcrypt.compareCoalescingStats();
+    expect(during.flights - before.flights).toBe(3);
+    expect(during.joined - before.joined).toBe(0);
+
+    return Promise.all(compares).then(results => {
+        expect(results).toStrictEqual([false, true, true]);
+        busy.setMaxInFlight(0);
+    });
+})
+
+test('followers_keep_their_async_context', () => {
+    const hash = bcrypt.hashSync('password', 4);
+    const storage = new AsyncLocalStorage();
+    bcrypt.coalesceCompares(true);
+    const compares = [1, 2, 3].map(id => storage.run(id, () => new Promise(resolve => {
+        bcrypt.compare('password', hash, () => resolve(storage.getStore()));
+    })));
+    return Promise.all(compares).then(stores => {
+        expect(stores).toStrictEqual([1, 2, 3]);
+    });
+})
+
+test('every_throwing_follower_is_uncaught', () => {
+    // in a child process, since the callbacks throw
+    const script = `
+        const bcrypt = require(${JSON.stringify(path.resolve(__dirname, '../bcrypt'))});
+        const seen = [];
+        process.on('uncaughtException', err => seen.push(err.message));
+        process.on('exit', () => console.log(JSON.stringify(seen.sort())));
+        bcrypt.coalesceCompares(true);
+        const hash = bcrypt.hashSync('password', 4);
+        for (let i = 0; i < 3; i++) {
+            bcrypt.compare('password', hash, () => { throw new Error('callback ' + i); });
+        }
+    `;
+    const result = spawnSync(process.execPath, ['-e', script], { encoding: 'utf8' });
+    expect(JSON.parse(result.stdout)).toStrictEqual(['callback 0', 'callback 1', 'callback 2']);
+})
@@ -0,0 +1,90 @@
+const bcrypt = require('../bcrypt');
+
+const salt = '$2b$04$......................';
+const hash = '$2b$04$......................CZJXs39HZ6odvxM3EvHl/Fh/PsT/WM6';
+
+afterEach(() => {
+    bcrypt.setInlineBudget(0);
+})
+
+test('inline_off', async () => {
+    const before = bcrypt.inlineStats();
+    expect(before.budget).toBe(0);
+    expect(await bcrypt.compare('pw', hash)).toBe(true);
+    const after = bcrypt.inlineStats();
+    expect(after.inline).toBe(before.inline);
+    expect(after.offloaded).toBe(before.offloaded);
+})
+
+test('inline_after_measuring', async () => {
+    bcrypt.setInlineBudget(1000);
+    const start = bcrypt.inlineStats();
+
+    // the first job at a cost is measured on the thread pool
+    expect(await bcrypt.compare('pw', hash)).toBe(true);
+    let stats = bcrypt.inlineStats();
+    expect(stats.offloaded).toBe(start.offloaded + 1);
+    expect(stats.costTime[4]).toBeGreaterThan(0);
+
+    expect(await bcrypt.compare('pw', hash)).toBe(true);
+    expect(await bcrypt.compare('other', hash)).toBe(false);
+    expect(await bcrypt.hash('pw', salt)).toBe(hash);
+    stats = bcrypt.inlineStats();
+    expect(stats.inline).toBe(start.inline + 3);
+    expect(stats.offloaded).toBe(start.offloaded + 1);
+})
+
+test('inline_settles_asynchronously', done => {
+    bcrypt.setInlineBudget(1000);
+    bcrypt.compare('pw', hash, function () {
+        let settled = false;
+        bcrypt.hash('pw', salt, function (err, result, cpuTime) {
+            settled = true;
+            expect(err).toBeUndefined();
+            expect(result).toBe(hash);
+            expect(cpuTime).toBeGreaterThan(0);
+            done();
+        });
+        expect(settled).toBe(false);
+    });
+})
+
+test('inline_over_budget', async () => {
+    bcrypt.setInlineBudget(0.000001);
+    const start = bcrypt.inlineStats();
+    expect(await bcrypt.compare('pw', hash)).toBe(true);
+    expect(await bcrypt.compare('pw', hash)).toBe(true);
+    const stats = bcrypt.inlineStats();
+    expect(stats.inline).toBe(start.inline);
+    expect(stats.offloaded).toBe(start.offloaded + 2);
+})
+
+test('inline_error', done => {
+    bcrypt.setInlineBudget(1000);
+    bcrypt.compare('pw', hash, function () {
+        // a malformed salt of a cheap cost fails inline the way it does on the pool
+        bcrypt.hash('pw', '$2b$04$', function (err) {
+            expect(err.message).toContain('Invalid salt');
+            done();
+        });
+    });
+})
+
+test('inline_unhashed_compare_not_timed', done => {
+    bcrypt.setInlineBudget(1000);
+    bcrypt.compare('pw', hash, function () {
+        const before = bcrypt.inlineStats().costTime[4];
+        // fails validation before hashing, so there is no CPU time to record
+        bcrypt.compare('pw', '$2b$04$', function (err, same, cpuTime) {
+            expect(same).toBe(false);
+            expect(cpuTime).toBe(0);
+            expect(bcrypt.inlineStats().costTime[4]).toBe(before);
+            done();
+        });
+    });
+})
+
+test('inline_invalid', () => {
+    expect(() => bcrypt.setInlineBudget(-1)).toThrowError('budget must be a non-negative number of milliseconds');
+    expect(() => bcrypt.setInlineBudget('1')).toThrowError('budget must be a non-negative number of milliseconds');
+})
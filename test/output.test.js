@@ -0,0 +1,80 @@
+const bcrypt = require('../bcrypt');
+
+const salt = '$2b$04$......................';
+const hash = '$2b$04$......................CZJXs39HZ6odvxM3EvHl/Fh/PsT/WM6';
+
+test('hash_into_sync', () => {
+    const output = Buffer.alloc(70, 0xff);
+    expect(bcrypt.hashIntoSync('pw', salt, output, 5)).toBe(60);
+    expect(output.toString('latin1', 5, 65)).toStrictEqual(hash);
+    expect(output[4]).toBe(0xff);
+    expect(output[65]).toBe(0xff);
+})
+
+test('hash_into_sync_default_offset', () => {
+    const output = Buffer.alloc(60);
+    expect(bcrypt.hashIntoSync('pw', salt, output)).toBe(60);
+    expect(output.toString()).toStrictEqual(hash);
+})
+
+test('hash_into_sync_invalid', () => {
+    expect(() => bcrypt.hashIntoSync('pw', salt, 'buffer')).toThrowError('output must be a Buffer');
+    expect(() => bcrypt.hashIntoSync('pw', salt, Buffer.alloc(59))).toThrowError('output must have 60 bytes available at offset');
+    expect(() => bcrypt.hashIntoSync('pw', salt, Buffer.alloc(64), 5)).toThrowError('output must have 60 bytes available at offset');
+    expect(() => bcrypt.hashIntoSync('pw', salt, Buffer.alloc(64), -1)).toThrowError('output must have 60 bytes available at offset');
+    expect(() => bcrypt.hashIntoSync('pw', '$2b$04$', Buffer.alloc(60))).toThrowError('Invalid salt');
+})
+
+test('hash_into', done => {
+    const output = Buffer.alloc(64);
+    bcrypt.hashInto('pw', salt, output, 4, function (err, length, cpuTime) {
+        expect(err).toBeUndefined();
+        expect(length).toBe(60);
+        expect(typeof cpuTime).toBe('number');
+        expect(output.toString('latin1', 4)).toStrictEqual(hash);
+        done();
+    });
+})
+
+test('hash_into_promise', async () => {
+    const output = Buffer.alloc(60);
+    expect(await bcrypt.hashInto('pw', 4, output)).toBe(60);
+    expect(bcrypt.compareSync('pw', output.toString())).toBe(true);
+})
+
+test('hash_into_invalid', done => {
+    bcrypt.hashInto('pw', salt, Buffer.alloc(10), function (err) {
+        expect(err.message).toBe('output must have 60 bytes available at offset');
+        done();
+    });
+})
+
+test('hash_slab_sync', () => {
+    const slab = bcrypt.hashSlab(2);
+    const first = slab.hashSync('pw', salt);
+    expect(first.toString()).toStrictEqual(hash);
+    expect(first.buffer).toBe(slab.buffer.buffer);
+    const second = slab.hashSync('other', salt);
+    expect(first.toString()).toStrictEqual(hash);
+    expect(second.toString()).not.toStrictEqual(hash);
+    // the third hash reuses the first slot
+    slab.hashSync('other', salt);
+    expect(first.toString()).toStrictEqual(second.toString());
+})
+
+test('hash_slab', async () => {
+    const slab = bcrypt.hashSlab(4);
+    const views = await Promise.all([1, 2, 3, 4].map(() => slab.hash('pw', salt)));
+    for (const view of views) {
+        expect(view.toString()).toStrictEqual(hash);
+    }
+    expect(new Set(views.map(view => view.byteOffset)).size).toBe(4);
+    expect(() => bcrypt.hashSlab(0)).toThrowError('slots must be a positive integer');
+})
+
+test('result_strings_ascii', () => {
+    const result = bcrypt.hashSync('pw', salt);
+    expect(result).toStrictEqual(hash);
+    expect(result.length).toBe(60);
+    expect(bcrypt.genSaltSync(4).length).toBe(29);
+})
@@ -0,0 +1,33 @@
+const bcrypt = require('../bcrypt');
+
+// vectors from OpenBSD's bcrypt_pbkdf regress tests, as used by pyca/bcrypt
+
+test('pbkdf_sync_vectors', () => {
+    expect(bcrypt.pbkdfSync('password', 'salt', 4, 32).toString('hex'))
+        .toStrictEqual('5bbf0cc293587f1c3635555c27796598d47e579071bf427e9d8fbe842aba34d9');
+    expect(bcrypt.pbkdfSync(Buffer.from('password'), Buffer.from([0]), 4, 16).toString('hex'))
+        .toStrictEqual('c12b566235eee04c212598970a579a67');
+})
+
+test('pbkdf_async_vectors', () => {
+    return bcrypt.pbkdf('password', 'salt', 4, 32).then(key => {
+        expect(key.toString('hex')).toStrictEqual('5bbf0cc293587f1c3635555c27796598d47e579071bf427e9d8fbe842aba34d9');
+    });
+})
+
+test('pbkdf_async_matches_sync_for_multi_block_keys', done => {
+    expect.assertions(2);
+    bcrypt.pbkdf('correct horse', 'battery staple', 2, 100, function (err, key) {
+        expect(err).toBeUndefined();
+        expect(key.equals(bcrypt.pbkdfSync('correct horse', 'battery staple', 2, 100))).toBe(true);
+        done();
+    });
+})
+
+test('pbkdf_invalid_args', () => {
+    expect(() => bcrypt.pbkdfSync('password', 'salt', 0, 32)).toThrowError('rounds must be a positive integer');
+    expect(() => bcrypt.pbkdfSync('password', 'salt', 4, 1025)).toThrowError('keyLen must be an integer between 1 and 1024');
+    expect(() => bcrypt.pbkdfSync('', 'salt', 4, 32)).toThrowError('password and salt must not be empty');
+    expect(() => bcrypt.pbkdfSync('password', 42, 4, 32)).toThrowError('password and salt must be strings or Buffers');
+    return expect(bcrypt.pbkdf('password', 'salt', 4)).rejects.toThrow('password, salt, rounds and keyLen arguments required');
+})
@@ -0,0 +1,97 @@
+const bcrypt = require('../bcrypt');
+
+test('callback_reports_cpu_time', done => {
+    expect.assertions(3);
+    bcrypt.hash('password', 4, function (err, hash, cpuTime) {
+        expect(err).toBeUndefined();
+        expect(typeof cpuTime).toBe('number');
+        bcrypt.compare('password', hash, function (err, same, cpuTime) {
+            expect(cpuTime).toBeGreaterThanOrEqual(0);
+            done();
+        });
+    });
+})
+
+test('tenant_in_flight_limit', () => {
+    const tenant = bcrypt.tenant('tenant_in_flight_limit', { maxInFlight: 1 });
+    const salt = bcrypt.genSaltSync(4);
+    const jobs = [];
+    for (let i = 0; i < 4; i++) {
+        jobs.push(tenant.hash('password' + i, salt));
+    }
+
+    const before = tenant.stats();
+    expect(before.maxInFlight).toBe(1);
+    expect(before.inFlight).toBe(1);
+    expect(before.pending).toBe(3);
+
+    return Promise.all(jobs).then(hashes => {
+        hashes.forEach((hash, i) => expect(bcrypt.compareSync('password' + i, hash)).toBe(true));
+        const after = tenant.stats();
+        expect(after.inFlight).toBe(0);
+        expect(after.pending).toBe(0);
+        expect(after.completed).toBe(4);
+        expect(after.cpuTime).toBeGreaterThan(0);
+    });
+})
+
+test('tenant_raising_limit_releases_pending', () => {
+    const tenant = bcrypt.tenant('tenant_raising_limit', { maxInFlight: 1 });
+    const hash = bcrypt.hashSync('password', 4);
+    const jobs = [tenant.compare('password', hash), tenant.compare('password', hash)];
+    expect(tenant.stats().pending).toBe(1);
+    tenant.setMaxInFlight(0);
+    expect(tenant.stats().pending).toBe(0);
+    expect(tenant.stats().inFlight).toBe(2);
+    return Promise.all(jobs).then(results => {
+        expect(results).toStrictEqual([true, true]);
+    });
+})
+
+test('tenant_errors', () => {
+    expect(() => bcrypt.tenant(42)).toThrowError('key must be a string');
+    expect(() => bcrypt.tenant('x', { maxInFlight: -1 })).toThrowError('maxInFlight must be a non-negative integer');
+    expect(bcrypt.tenant('unused').stats().completed).toBe(0);
+})
+
+test('tenant_usage_survives_idle', async () => {
+    const unlimited = bcrypt.tenant('tenant_usage_survives_idle');
+    const limited = bcrypt.tenant('tenant_usage_with_limit', { maxInFlight: 4 });
+    const hash = bcrypt.hashSync('password', 4);
+
+    // two bursts with idle time in between: the totals carry over
+    await Promise.all([unlimited.compare('password', hash), limited.compare('password', hash)]);
+    const first = unlimited.stats();
+    expect(first).toMatchObject({ maxInFlight: 0, inFlight: 0, pending: 0, completed: 1 });
+    expect(first.cpuTime).toBeGreaterThan(0);
+    await Promise.all([unlimited.compare('password', hash), unlimited.compare('wrong', hash)]);
+    const second = unlimited.stats();
+    expect(second.completed).toBe(3);
+    expect(second.cpuTime).toBeGreaterThan(first.cpuTime);
+
+    // dropping the limit does not lose the totals either
+    limited.setMaxInFlight(0);
+    expect(limited.stats().completed).toBe(1);
+
+    const taken = unlimited.takeStats();
+    expect(taken).toStrictEqual({ completed: 3, cpuTime: second.cpuTime });
+    expect(unlimited.stats()).toStrictEqual({ maxInFlight: 0, inFlight: 0, pending: 0, completed: 0, cpuTime: 0 });
+    expect(unlimited.takeStats()).toStrictEqual({ completed: 0, cpuTime: 0 });
+})
+
+test('take_tenant_stats', async () => {
+    const hash = bcrypt.hashSync('password', 4);
+    bcrypt.takeTenantStats();
+    await Promise.all([
+        bcrypt.tenant('take_a').compare('password', hash),
+        bcrypt.tenant('take_a').compare('password', hash),
+        bcrypt.tenant('take_b').compare('password', hash),
+    ]);
+    const all = bcrypt.takeTenantStats();
+    expect(Object.keys(all).sort()).toStrictEqual(['take_a', 'take_b']);
+    expect(all.take_a.completed).toBe(2);
+    expect(all.take_b.completed).toBe(1);
+    expect(all.take_a.cpuTime).toBeGreaterThan(0);
+    expect(bcrypt.takeTenantStats()).toStrictEqual({});
+    expect(bcrypt.tenant('take_a').stats().completed).toBe(0);
+})
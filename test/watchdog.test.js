@@ -0,0 +1,78 @@
+const bcrypt = require('../bcrypt');
+
+const hash = '$2b$04$......................CZJXs39HZ6odvxM3EvHl/Fh/PsT/WM6';
+
+afterEach(() => {
+    bcrypt.watchSyncCalls(false);
+})
+
+function login(password) {
+    return bcrypt.compareSync(password, hash);
+}
+
+test('watchdog_off', () => {
+    expect(login('pw')).toBe(true);
+    expect(bcrypt.syncCallStats()).toStrictEqual({ enabled: false, sites: {} });
+})
+
+test('watchdog_counts_by_site', () => {
+    bcrypt.watchSyncCalls({ threshold: 10000 });
+    expect(login('pw')).toBe(true);
+    expect(login('other')).toBe(false);
+    bcrypt.hashSync('pw', hash.slice(0, 29));
+
+    const stats = bcrypt.syncCallStats();
+    expect(stats.enabled).toBe(true);
+    const sites = Object.keys(stats.sites);
+    expect(sites.length).toBe(2);
+    const site = sites.find(name => name.startsWith('login '));
+    expect(site).toContain('watchdog.test.js');
+    const entry = stats.sites[site];
+    expect(entry.calls).toBe(2);
+    expect(entry.slow).toBe(0);
+    expect(entry.histogram.length).toBe(12);
+    expect(entry.histogram.reduce((a, b) => a + b, 0)).toBe(2);
+    expect(entry.maxTime).toBeGreaterThan(0);
+    expect(entry.totalTime).toBeGreaterThanOrEqual(entry.maxTime);
+    expect(entry.stack).toBeUndefined();
+})
+
+test('watchdog_warn', () => {
+    const warnings = [];
+    const onWarning = warning => warnings.push(warning);
+    process.on('warning', onWarning);
+    bcrypt.watchSyncCalls({ threshold: 0, captureStack: true });
+    expect(login('pw')).toBe(true);
+    return new Promise(resolve => setImmediate(resolve)).then(() => {
+        process.removeListener('warning', onWarning);
+        expect(warnings.length).toBe(1);
+        expect(warnings[0].name).toBe('BcryptSyncWarning');
+        expect(warnings[0].message).toMatch(/^compareSync at cost 4 blocked the event loop for [0-9.]+ ms \(threshold 0\.0 ms\) at login /);
+        const site = Object.values(bcrypt.syncCallStats().sites)[0];
+        expect(site.slow).toBe(1);
+        expect(site.stack).toContain('watchdog.test.js');
+    });
+})
+
+test('watchdog_throw', () => {
+    bcrypt.watchSyncCalls({ threshold: 0, policy: 'throw' });
+    expect(() => login('pw')).toThrowError(/^compareSync at cost 4 blocked the event loop/);
+})
+
+test('watchdog_reject', () => {
+    bcrypt.watchSyncCalls({ threshold: 0, policy: 'reject' });
+    const warning = jest.spyOn(process, 'emitWarning').mockImplementation(() => {});
+    // nothing timed yet, so the first call runs
+    expect(login('pw')).toBe(true);
+    expect(warning).toHaveBeenCalledTimes(1);
+    warning.mockRestore();
+    // a higher cost is predicted from it and refused up front
+    expect(() => bcrypt.hashSync('pw', 8)).toThrowError(/^hashSync at cost 8 would block the event loop for about [0-9.]+ ms/);
+    const rejected = Object.values(bcrypt.syncCallStats().sites).reduce((a, site) => a + site.rejected, 0);
+    expect(rejected).toBe(1);
+})
+
+test('watchdog_invalid', () => {
+    expect(() => bcrypt.watchSyncCalls({ policy: 'ignore' })).toThrowError('policy must be one of warn, throw, reject');
+    expect(() => bcrypt.watchSyncCalls({ threshold: -1 })).toThrowError('threshold must be a non-negative number of milliseconds');
+})